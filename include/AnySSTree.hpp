@@ -0,0 +1,78 @@
+#ifndef INCLUDE_ANYSSTREE_HPP_
+#define INCLUDE_ANYSSTREE_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "Capacities.hpp"
+#include "Data.hpp"
+#include "Neighbor.hpp"
+#include "Point.hpp"
+#include "Projection.hpp"
+#include "SSTree.hpp"
+#include "SearchFilter.hpp"
+
+// SSTree whose node capacity is chosen at runtime
+class AnySSTree {
+public:
+  AnySSTree() = default;
+  AnySSTree(const AnySSTree &) = delete;
+  auto operator=(const AnySSTree &) -> AnySSTree & = delete;
+  AnySSTree(AnySSTree &&) = delete;
+  auto operator=(AnySSTree &&) -> AnySSTree & = delete;
+  virtual ~AnySSTree() = default;
+
+  [[nodiscard]] virtual auto get_max_points_per_node() const -> size_t = 0;
+
+  virtual void set_projection(const Projection &projection) = 0;
+  virtual void insert(const std::shared_ptr<Data> &data) = 0;
+  virtual auto knn(const Point &target, size_t k,
+                   const SearchFilter &filter) const
+      -> std::vector<Neighbor> = 0;
+  virtual auto range(const Point &target, float radius,
+                     const SearchFilter &filter) const
+      -> std::vector<Neighbor> = 0;
+  virtual void flush() = 0;
+};
+
+template <size_t MAX_POINTS_PER_NODE>
+class SSTreeAdapter final : public AnySSTree {
+private:
+  SSTree<MAX_POINTS_PER_NODE> m_tree;
+
+public:
+  explicit SSTreeAdapter(const WriteBufferOptions &buffer_options)
+      : m_tree(buffer_options) {}
+
+  [[nodiscard]] auto get_max_points_per_node() const -> size_t override {
+    return MAX_POINTS_PER_NODE;
+  }
+  [[nodiscard]] auto get_tree() -> SSTree<MAX_POINTS_PER_NODE> & {
+    return m_tree;
+  }
+
+  void set_projection(const Projection &projection) override {
+    m_tree.set_projection(projection);
+  }
+  void insert(const std::shared_ptr<Data> &data) override {
+    m_tree.insert(data);
+  }
+  auto knn(const Point &target, size_t k, const SearchFilter &filter) const
+      -> std::vector<Neighbor> override {
+    return m_tree.knn(target, k, filter);
+  }
+  auto range(const Point &target, float radius,
+             const SearchFilter &filter) const
+      -> std::vector<Neighbor> override {
+    return m_tree.range(target, radius, filter);
+  }
+  void flush() override { m_tree.flush(); }
+};
+
+// Throws std::invalid_argument if max_points_per_node is not one of
+// SUPPORTED_CAPACITIES
+auto make_sstree(size_t max_points_per_node,
+                 const WriteBufferOptions &buffer_options = {})
+    -> std::unique_ptr<AnySSTree>;
+
+#endif // INCLUDE_ANYSSTREE_HPP_
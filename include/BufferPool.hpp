@@ -0,0 +1,132 @@
+#ifndef INCLUDE_BUFFERPOOL_HPP_
+#define INCLUDE_BUFFERPOOL_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class PageFileMode {
+  CREATE, // Creates the file, or truncates an existing one
+  OPEN,   // Opens an existing file, keeping its pages
+};
+
+// File of fixed-size pages, each holding page_floats floats
+class PageFile {
+private:
+  size_t m_page_floats;
+  mutable std::mutex m_mutex;
+  mutable std::fstream m_file;
+
+public:
+  PageFile(const std::string &path, size_t page_floats,
+           PageFileMode mode = PageFileMode::CREATE);
+
+  [[nodiscard]] auto get_page_floats() const -> size_t {
+    return m_page_floats;
+  }
+
+  // Buffered: call flush() once every page is written
+  void write_page(uint64_t page_id, const float *data);
+  void read_page(uint64_t page_id, float *data) const;
+  void flush();
+};
+
+struct BufferPoolStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+  size_t prefetches = 0;
+};
+
+// Fixed number of in-memory frames caching pages of a PageFile.
+// Pinned frames are never evicted; the rest are replaced with CLOCK.
+// prefetch() loads pages on a background thread so the I/O overlaps with the
+// caller's work.
+class BufferPool {
+private:
+  enum class FrameState { EMPTY, LOADING, READY };
+
+  struct Frame {
+    uint64_t page_id = 0;
+    size_t pin_count = 0;
+    bool referenced = false;
+    FrameState state = FrameState::EMPTY;
+  };
+
+  const PageFile &m_file;
+  std::vector<float> m_frame_data;
+  std::vector<Frame> m_frames;
+  std::unordered_map<uint64_t, size_t> m_page_table;
+  size_t m_clock_hand = 0;
+  BufferPoolStats m_stats;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_frame_cv;
+
+  std::deque<uint64_t> m_prefetch_queue;
+  std::condition_variable_any m_prefetch_cv;
+  std::jthread m_prefetch_thread; // Last member: joined before the rest dies
+
+  auto find_victim() -> std::optional<size_t>;
+  auto load(std::unique_lock<std::mutex> &lock, uint64_t page_id,
+            bool wait_for_frame) -> std::optional<size_t>;
+  void unpin(size_t frame);
+  void prefetch_worker(const std::stop_token &stop_token);
+
+public:
+  // Keeps a page pinned (resident) while alive
+  class PageHandle {
+  private:
+    BufferPool *m_pool;
+    size_t m_frame;
+
+  public:
+    PageHandle(BufferPool *pool, size_t frame)
+        : m_pool(pool), m_frame(frame) {}
+    PageHandle(const PageHandle &) = delete;
+    auto operator=(const PageHandle &) -> PageHandle & = delete;
+    PageHandle(PageHandle &&other) noexcept
+        : m_pool(std::exchange(other.m_pool, nullptr)),
+          m_frame(other.m_frame) {}
+    auto operator=(PageHandle &&) -> PageHandle & = delete;
+    ~PageHandle() {
+      if (m_pool != nullptr) {
+        m_pool->unpin(m_frame);
+      }
+    }
+
+    [[nodiscard]] auto data() const -> const float * {
+      return m_pool->m_frame_data.data() +
+             m_frame * m_pool->m_file.get_page_floats();
+    }
+  };
+
+  BufferPool(const PageFile &file, size_t num_frames);
+
+  BufferPool(const BufferPool &) = delete;
+  auto operator=(const BufferPool &) -> BufferPool & = delete;
+  BufferPool(BufferPool &&) = delete;
+  auto operator=(BufferPool &&) -> BufferPool & = delete;
+  ~BufferPool() = default;
+
+  // Loads the page if needed and pins it; blocks while every frame is pinned
+  auto pin(uint64_t page_id) -> PageHandle;
+
+  // Asks the background thread to load the page, without pinning it
+  void prefetch(uint64_t page_id);
+
+  [[nodiscard]] auto get_num_frames() const -> size_t {
+    return m_frames.size();
+  }
+  [[nodiscard]] auto get_stats() const -> BufferPoolStats;
+};
+
+#endif // INCLUDE_BUFFERPOOL_HPP_
@@ -0,0 +1,18 @@
+#ifndef INCLUDE_CAPACITIES_HPP_
+#define INCLUDE_CAPACITIES_HPP_
+
+#include <array>
+#include <cstddef>
+
+// Node capacities (MAX_POINTS_PER_NODE) every tree template is explicitly
+// instantiated for. SSTree, ShardedSSTree, TieredSSTree and make_sstree all
+// expand this one list, so the supported sets cannot drift apart.
+#define SSTREE_FOR_EACH_CAPACITY(X)                                            \
+  X(7) X(8) X(11) X(16) X(20) X(24) X(32) X(48) X(64)
+
+#define SSTREE_CAPACITY_VALUE(N) N,
+inline constexpr std::array<std::size_t, 9> SUPPORTED_CAPACITIES = {
+    SSTREE_FOR_EACH_CAPACITY(SSTREE_CAPACITY_VALUE)};
+#undef SSTREE_CAPACITY_VALUE
+
+#endif // INCLUDE_CAPACITIES_HPP_
@@ -0,0 +1,40 @@
+#ifndef INCLUDE_CAPACITYTUNER_HPP_
+#define INCLUDE_CAPACITYTUNER_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "AnySSTree.hpp"
+#include "Data.hpp"
+#include "Point.hpp"
+
+struct TuningOptions {
+  size_t k = 10;
+  // Fraction of the true k nearest neighbors a capacity must return
+  float target_recall = 1.0F;
+  // Each query batch runs this many times, the fastest run counts
+  size_t repetitions = 3;
+  std::vector<size_t> candidates{SUPPORTED_CAPACITIES.begin(),
+                                 SUPPORTED_CAPACITIES.end()};
+};
+
+struct CapacityTrial {
+  size_t max_points_per_node;
+  float recall;
+  double mean_latency_us; // Per query
+};
+
+struct TuningResult {
+  size_t max_points_per_node; // Fastest capacity reaching the target recall
+  std::vector<CapacityTrial> trials;
+};
+
+// Builds one tree per candidate capacity over `sample`, measures kNN latency
+// and recall (against a brute-force scan) for `queries`, and picks the
+// fastest capacity reaching the target recall. Throws std::runtime_error if
+// none does.
+auto tune_capacity(const std::vector<std::shared_ptr<Data>> &sample,
+                   const std::vector<Point> &queries,
+                   const TuningOptions &options = {}) -> TuningResult;
+
+#endif // INCLUDE_CAPACITYTUNER_HPP_
@@ -1,6 +1,7 @@
 #ifndef INCLUDE_DATA_HPP_
 #define INCLUDE_DATA_HPP_
 
+#include <cstdint>
 #include <string>
 #include <utility>
 
@@ -10,10 +11,12 @@ class Data {
 private:
   std::string m_image_path;
   Point m_embedding;
+  uint64_t m_id;
 
 public:
-  Data(const Point &_embedding, std::string image_path)
-      : m_image_path(std::move(image_path)), m_embedding(_embedding) {}
+  Data(const Point &_embedding, std::string image_path, uint64_t _id = 0)
+      : m_image_path(std::move(image_path)), m_embedding(_embedding),
+        m_id(_id) {}
 
   // Getters
   [[nodiscard]] auto get_embedding() const -> const Point & {
@@ -22,6 +25,7 @@ public:
   [[nodiscard]] auto get_path() const -> const std::string & {
     return m_image_path;
   }
+  [[nodiscard]] auto get_id() const -> uint64_t { return m_id; }
 
   auto operator<=>(const Data &other) const {
     return m_image_path <=> other.m_image_path;
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_DATASET_HPP_
+#define INCLUDE_DATASET_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Data.hpp"
+#include "Point.hpp"
+
+// Counter-based generator: the n-th number of stream s only depends on
+// (seed, s, n), so any range of points can be generated on any thread and
+// always yields the same values.
+class CounterRng {
+private:
+  uint64_t m_key;
+  uint64_t m_counter = 0;
+
+public:
+  CounterRng(uint64_t seed, uint64_t stream);
+
+  auto next() -> uint64_t;
+  // Uniform in [0, 1)
+  auto uniform() -> float;
+  // Standard normal (Box-Muller)
+  auto normal() -> float;
+};
+
+enum class Distribution {
+  UNIFORM,          // Every coordinate uniform in [min, max)
+  GAUSSIAN_MIXTURE, // Isotropic gaussian blobs around random centers
+  ANISOTROPIC,      // One gaussian whose spread decays along the dimensions
+};
+
+struct DatasetOptions {
+  Distribution distribution = Distribution::GAUSSIAN_MIXTURE;
+  size_t num_points = 0;
+  uint64_t seed = 0;
+  float min = 0.0F;
+  float max = 1.0F;
+  size_t num_clusters = 16;
+  // Standard deviation of a cluster, or of the first anisotropic dimension
+  float spread = 0.05F;
+  // Dimension i of the anisotropic distribution has spread * (i+1)^-decay
+  float decay = 0.5F;
+  size_t num_threads = 0; // 0 = hardware concurrency
+  // Generator stream of the first point. Points past the end of a dataset
+  // (first_index = its num_points) are new samples of the same distribution.
+  uint64_t first_index = 0;
+};
+
+// Synthetic embeddings stored row-major, DIM floats per point
+class Dataset {
+private:
+  std::vector<float> m_embeddings;
+
+public:
+  Dataset() = default;
+
+  static auto generate(const DatasetOptions &options) -> Dataset;
+  static auto load(const std::string &path) -> Dataset;
+  void save(const std::string &path) const;
+
+  [[nodiscard]] auto size() const -> size_t {
+    return m_embeddings.size() / DIM;
+  }
+  [[nodiscard]] auto get_point(size_t index) const -> Point;
+  // One Data per point, with id = index and path point_path(index)
+  [[nodiscard]] auto to_data() const -> std::vector<std::shared_ptr<Data>>;
+  // "image_<index>.jpg"
+  static auto point_path(size_t index) -> std::string;
+
+  auto operator==(const Dataset &other) const -> bool = default;
+};
+
+// Sequential reader of a file written by Dataset::save, for datasets that
+// should not be loaded whole
+class DatasetReader {
+private:
+  std::ifstream m_file;
+  std::string m_path;
+  size_t m_size = 0;
+  size_t m_next = 0; // Index of the next point to read
+
+public:
+  explicit DatasetReader(const std::string &path);
+
+  [[nodiscard]] auto size() const -> size_t { return m_size; }
+  // Index of the first point the next read() returns
+  [[nodiscard]] auto position() const -> size_t { return m_next; }
+
+  // Replaces `embeddings` with up to max_points rows, DIM floats each;
+  // returns the number of points read (0 at the end of the file)
+  auto read(size_t max_points, std::vector<float> &embeddings) -> size_t;
+  // Goes back to the first point
+  void rewind();
+};
+
+#endif // INCLUDE_DATASET_HPP_
@@ -0,0 +1,17 @@
+#ifndef INCLUDE_KMEANS_HPP_
+#define INCLUDE_KMEANS_HPP_
+
+#include <vector>
+
+#include "Point.hpp"
+
+// Lloyd's k-means over a sample, seeded with evenly spaced sample points.
+// Throws std::invalid_argument if the sample has fewer than k points.
+auto kmeans(const std::vector<Point> &sample, size_t k, size_t iterations)
+    -> std::vector<Point>;
+
+// Index of the centroid closest to `point`
+auto nearest_centroid(const std::vector<Point> &centroids, const Point &point)
+    -> size_t;
+
+#endif // INCLUDE_KMEANS_HPP_
@@ -0,0 +1,84 @@
+#ifndef INCLUDE_NEIGHBOR_HPP_
+#define INCLUDE_NEIGHBOR_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Data.hpp"
+
+// A kNN result: a stored entry and its distance to the query point
+struct Neighbor {
+  float distance;
+  std::shared_ptr<Data> data;
+};
+
+// Bounded max-heap that keeps the k closest neighbors seen so far.
+// Heaps searching disjoint partitions for the same query can share a bound:
+// once one of them holds k neighbors, nothing farther than its k-th best can
+// be in the merged top k, so every other heap rejects it too.
+class NeighborHeap {
+private:
+  size_t m_k;
+  std::vector<Neighbor> m_heap;
+  std::atomic<float> *m_shared_bound;
+
+  [[nodiscard]] auto local_worst_distance() const -> float {
+    return full() && !m_heap.empty() ? m_heap.front().distance
+                                     : std::numeric_limits<float>::max();
+  }
+
+  void publish_bound() {
+    if (m_shared_bound == nullptr || !full()) {
+      return;
+    }
+    auto bound = local_worst_distance();
+    auto shared = m_shared_bound->load(std::memory_order_relaxed);
+    while (bound < shared && !m_shared_bound->compare_exchange_weak(
+                                 shared, bound, std::memory_order_relaxed)) {
+    }
+  }
+
+public:
+  explicit NeighborHeap(size_t k, std::atomic<float> *shared_bound = nullptr)
+      : m_k(k), m_shared_bound(shared_bound) {
+    m_heap.reserve(k + 1);
+  }
+
+  [[nodiscard]] auto get_k() const -> size_t { return m_k; }
+  [[nodiscard]] auto size() const -> size_t { return m_heap.size(); }
+  [[nodiscard]] auto full() const -> bool { return m_heap.size() >= m_k; }
+
+  // Distance a candidate has to beat to enter the heap
+  [[nodiscard]] auto worst_distance() const -> float {
+    auto worst = local_worst_distance();
+    return m_shared_bound == nullptr
+               ? worst
+               : std::min(worst,
+                          m_shared_bound->load(std::memory_order_relaxed));
+  }
+
+  void push(float distance, const std::shared_ptr<Data> &data) {
+    if (m_k == 0 || distance >= worst_distance()) {
+      return;
+    }
+    m_heap.push_back({distance, data});
+    std::ranges::push_heap(m_heap, {}, &Neighbor::distance);
+    if (m_heap.size() > m_k) {
+      std::ranges::pop_heap(m_heap, {}, &Neighbor::distance);
+      m_heap.pop_back();
+    }
+    publish_bound();
+  }
+
+  // Returns the neighbors ordered from closest to farthest
+  [[nodiscard]] auto take_sorted() -> std::vector<Neighbor> {
+    std::ranges::sort_heap(m_heap, {}, &Neighbor::distance);
+    return std::exchange(m_heap, {});
+  }
+};
+
+#endif // INCLUDE_NEIGHBOR_HPP_
@@ -4,9 +4,25 @@
 #include <immintrin.h>
 
 #include <array>
+#include <cstdint>
 
 constexpr std::size_t DIM = 768;
 
+// Early-abandoning distances check the running sum once per block
+constexpr std::size_t DISTANCE_BLOCK = 64;
+constexpr std::size_t NUM_DISTANCE_BLOCKS = DIM / DISTANCE_BLOCK;
+static_assert(DIM % DISTANCE_BLOCK == 0);
+
+// Work done by bounded_squared_distance on the calling thread
+struct DistanceWork {
+  uint64_t calls = 0;
+  uint64_t blocks = 0; // At most calls * NUM_DISTANCE_BLOCKS
+
+  auto operator-(const DistanceWork &other) const -> DistanceWork {
+    return {.calls = calls - other.calls, .blocks = blocks - other.blocks};
+  }
+};
+
 class Point {
 public:
   Point() = default;
@@ -27,8 +43,25 @@ public:
   auto operator[](std::size_t index) const -> float;
   auto operator[](std::size_t index) -> float &;
 
+  // Raw access to the DIM contiguous coordinates
+  [[nodiscard]] auto data() const -> const float * {
+    return m_coordinates.data();
+  }
+
   static auto random(float min = 0.0F, float max = 1.0F) -> Point;
   static auto distance(const Point &point1, const Point &point2) -> float;
+  // Squared euclidean distance between two blocks of DIM floats
+  static auto squared_distance(const float *lhs, const float *rhs) -> float;
+  // Same sum, block by block in memory order, that stops once it reaches
+  // `bound`. Exact when the result is below `bound`.
+  static auto bounded_squared_distance(const float *lhs, const float *rhs,
+                                       float bound) -> float;
+  // Squared distance restricted to block `block`
+  static auto block_squared_distance(const float *lhs, const float *rhs,
+                                     size_t block) -> float;
+  // Running totals of this thread, e.g. to measure how much early
+  // abandoning saves over a search
+  static auto distance_work() -> DistanceWork;
 
 private:
   std::array<float, DIM> m_coordinates = {0.0F};
@@ -0,0 +1,40 @@
+#ifndef INCLUDE_PROJECTION_HPP_
+#define INCLUDE_PROJECTION_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Point.hpp"
+
+constexpr std::size_t PROJECTED_DIM = 32;
+
+using ProjectedPoint = std::array<float, PROJECTED_DIM>;
+
+// Linear map from DIM to PROJECTED_DIM dimensions with orthonormal rows.
+// Projecting can only shrink distances, so the distance between two projected
+// points is a lower bound of the distance between the original points.
+class Projection {
+private:
+  // PROJECTED_DIM rows of DIM floats, row-major
+  std::vector<float> m_rows;
+
+  Projection() : m_rows(PROJECTED_DIM * DIM, 0.0F) {}
+
+  void orthonormalize();
+
+public:
+  // Random orthonormal projection
+  static auto random(uint64_t seed) -> Projection;
+  // Top PROJECTED_DIM principal components of the sample (subspace iteration)
+  static auto pca(const std::vector<Point> &sample,
+                  size_t iterations = 8) -> Projection;
+
+  [[nodiscard]] auto project(const Point &point) const -> ProjectedPoint;
+
+  // Lower bound of the distance between the points that were projected
+  static auto lower_bound(const ProjectedPoint &point1,
+                          const ProjectedPoint &point2) -> float;
+};
+
+#endif // INCLUDE_PROJECTION_HPP_
@@ -0,0 +1,73 @@
+#ifndef INCLUDE_QUERYPROTOCOL_HPP_
+#define INCLUDE_QUERYPROTOCOL_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Neighbor.hpp"
+#include "Point.hpp"
+
+// Binary protocol of the query server. Both ends run on the same machine, so
+// integers and floats travel in native byte order.
+//
+// Every message is a fixed header followed by `payload_size` bytes:
+//   KNN request:    uint32 k, float[DIM] query
+//   RANGE request:  float radius, float[DIM] query
+//   INSERT request: uint64 id, float[DIM] embedding, path (rest of payload)
+//   Response:       uint32 count, then per entry uint64 id, float distance,
+//                   uint32 path size, path bytes
+// Responses carry ids and paths only, never embeddings.
+
+enum class RequestType : uint32_t {
+  KNN = 1,
+  RANGE = 2,
+  INSERT = 3,
+};
+
+enum class ResponseStatus : uint32_t {
+  OK = 0,
+  BAD_REQUEST = 1,
+  ERROR = 2,
+};
+
+struct RequestHeader {
+  uint32_t payload_size;
+  RequestType type;
+  uint64_t request_id;
+};
+
+struct ResponseHeader {
+  uint32_t payload_size;
+  ResponseStatus status;
+  uint64_t request_id;
+};
+
+// Larger payloads are rejected before buffering them
+constexpr uint32_t MAX_PAYLOAD_SIZE = 1U << 20U;
+
+// A decoded request; `query` is the embedding for inserts
+struct Request {
+  RequestType type;
+  uint64_t request_id;
+  Point query;
+  uint32_t k = 0;
+  float radius = 0.0F;
+  uint64_t id = 0;
+  std::string path{};
+};
+
+// Appends a complete request message to `out`
+void encode_request(const Request &request, std::vector<char> &out);
+// Decodes a request payload; nullopt if it is malformed
+auto decode_request(const RequestHeader &header,
+                    std::span<const char> payload) -> std::optional<Request>;
+
+// Appends a complete response message to `out`
+void encode_response(uint64_t request_id, ResponseStatus status,
+                     const std::vector<Neighbor> &neighbors,
+                     std::vector<char> &out);
+
+#endif // INCLUDE_QUERYPROTOCOL_HPP_
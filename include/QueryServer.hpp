@@ -0,0 +1,112 @@
+#ifndef INCLUDE_QUERYSERVER_HPP_
+#define INCLUDE_QUERYSERVER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AnySSTree.hpp"
+#include "QueryProtocol.hpp"
+#include "WorkerThread.hpp"
+
+struct ServerOptions {
+  std::string socket_path;
+  // A batch runs once it holds this many requests...
+  size_t max_batch_size = 64;
+  // ...or once its oldest request has waited this long
+  std::chrono::microseconds max_wait{200};
+  size_t num_workers = 4;
+};
+
+struct ServerStats {
+  uint64_t requests = 0;
+  uint64_t batches = 0;
+  uint64_t connections = 0;
+};
+
+// Serves QueryProtocol requests over a Unix domain socket (Linux only).
+// One epoll thread reads requests from every connection into a micro-batch.
+// A batch runs its inserts in arrival order, then its queries in parallel on
+// the worker threads. Meanwhile the epoll thread keeps accepting, reading
+// into the next batch and sending responses; one batch runs at a time, and
+// connections stop being read while the next one is already full.
+// Batching only amortises the reads, wakeups and hand-off to the workers:
+// each query still runs its own search of the tree.
+// Every connection gets its responses, malformed requests included, in the
+// order it sent the requests. A client that shuts down its writing side is
+// still answered, and closed once its responses are sent.
+class QueryServer {
+private:
+  struct Connection {
+    int fd;
+    std::vector<char> input{};
+    std::vector<char> output{};
+    size_t output_offset = 0;
+    uint32_t events = 0; // Registered with epoll, 0 if not registered
+    bool eof = false;    // The peer shut down its writing side
+    bool paused = false; // Not read until the next batch starts
+    size_t in_batch = 0; // Requests waiting for a response
+  };
+  struct PendingRequest {
+    uint64_t connection;
+    Request request;
+    // Entries enqueued as BAD_REQUEST are answered without running
+    ResponseStatus status = ResponseStatus::OK;
+  };
+
+  AnySSTree &m_tree;
+  ServerOptions m_options;
+  int m_listen_fd = -1;
+  int m_epoll_fd = -1;
+  int m_stop_fd = -1;  // eventfd written by stop()
+  int m_timer_fd = -1; // Fires at the deadline of the pending batch
+  int m_done_fd = -1;  // eventfd written when the running batch finishes
+  uint64_t m_next_connection = 0;
+  std::unordered_map<uint64_t, Connection> m_connections;
+  std::vector<uint64_t> m_paused; // Connections waiting for m_batch to start
+  std::vector<PendingRequest> m_batch; // Next batch, filled by the epoll thread
+  bool m_batch_due = false;            // Its deadline passed while one ran
+  // Running batch; only the workers touch it until m_done_fd fires
+  std::vector<PendingRequest> m_running;
+  std::vector<std::vector<Neighbor>> m_results;
+  std::vector<ResponseStatus> m_statuses;
+  std::atomic<size_t> m_running_workers{0};
+  ServerStats m_stats;
+  std::vector<std::unique_ptr<WorkerThread>> m_workers;
+
+  void accept_connections();
+  void read_requests(uint64_t connection_id);
+  void flush_output(uint64_t connection_id);
+  void update_events(uint64_t connection_id, Connection &connection);
+  void close_connection(uint64_t connection_id);
+  void enqueue(uint64_t connection_id, const Request &request,
+               ResponseStatus status);
+  void start_batch();
+  void finish_batch();
+  void arm_timer(std::chrono::microseconds delay) const;
+
+public:
+  // Binds and listens on options.socket_path; throws std::system_error
+  QueryServer(AnySSTree &tree, const ServerOptions &options);
+
+  QueryServer(const QueryServer &) = delete;
+  auto operator=(const QueryServer &) -> QueryServer & = delete;
+  QueryServer(QueryServer &&) = delete;
+  auto operator=(QueryServer &&) -> QueryServer & = delete;
+  ~QueryServer();
+
+  // Serves until stop() is called
+  void run();
+  // Async-signal-safe
+  void stop() const;
+
+  [[nodiscard]] auto get_stats() const -> const ServerStats & {
+    return m_stats;
+  }
+};
+
+#endif // INCLUDE_QUERYSERVER_HPP_
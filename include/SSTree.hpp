@@ -1,13 +1,24 @@
 #ifndef INCLUDE_SSTREE_HPP_
 #define INCLUDE_SSTREE_HPP_
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <span>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "Capacities.hpp"
 #include "Data.hpp"
+#include "Neighbor.hpp"
 #include "Point.hpp"
+#include "Projection.hpp"
+#include "SearchFilter.hpp"
+#include "WriteBuffer.hpp"
 
 template <size_t MAX_POINTS_PER_NODE> class SSNode;
 
@@ -24,44 +35,74 @@ private:
 
   Point m_centroid;
   float m_radius;
+  IdRange m_id_range{}; // Ids of every entry below the node
   bool m_isLeaf;
   std::weak_ptr<SSNode> m_parent;
   std::vector<std::shared_ptr<SSNode>> m_children;
   std::vector<std::shared_ptr<Data>> m_data;
+  // Distance of each entry (data embedding or child centroid) to m_centroid,
+  // in the same order as m_data / m_children
+  std::vector<float> m_entry_distances;
+  // Optional low-dimensional routing key, shared by every node of a tree
+  std::shared_ptr<const Projection> m_projection;
+  ProjectedPoint m_projected_centroid{};
 
   using split_t = std::optional<
       std::pair<std::shared_ptr<SSNode>, std::shared_ptr<SSNode>>>;
 
   // For searching
-  auto find_closest_child(const Point &target) -> std::shared_ptr<SSNode>;
+  auto find_closest_child(const Point &target,
+                          const ProjectedPoint *projected_target = nullptr)
+      -> std::shared_ptr<SSNode>;
+  auto search_parent_leaf(const Point &target,
+                          const ProjectedPoint *projected_target)
+      -> std::shared_ptr<SSNode>;
+  auto project(const Point &target) const -> std::optional<ProjectedPoint>;
 
   // For insertion
   void update_bounding_envelope();
   auto direction_of_max_variance() -> size_t;
   auto split() -> split_t;
   auto find_split_index(size_t coordinate_index) -> size_t;
-  auto get_entries_centroids() -> std::vector<Point>;
+  [[nodiscard]] auto get_num_entries() const -> size_t {
+    return m_isLeaf ? m_data.size() : m_children.size();
+  }
+  [[nodiscard]] auto get_entry_centroid(size_t index) const -> const Point &;
   [[nodiscard]] auto
-  min_variance_split(const std::vector<float> &values) const -> size_t;
+  min_variance_split(std::span<const float> sorted_values) const -> size_t;
+  // Room for one entry over the limit, so inserts never reallocate
+  void reserve_entries() {
+    if (m_isLeaf) {
+      m_data.reserve(MAX_POINTS_PER_NODE + 1);
+    } else {
+      m_children.reserve(MAX_POINTS_PER_NODE + 1);
+    }
+    m_entry_distances.reserve(MAX_POINTS_PER_NODE + 1);
+  }
+  auto insert(const std::shared_ptr<Data> &data,
+              const ProjectedPoint *projected_target) -> split_t;
 
 public:
   SSNode(const Point &_centroid, float _radius, bool _isLeaf = true,
          const std::shared_ptr<SSNode> &_parent = nullptr)
       : m_centroid(_centroid), m_radius(_radius), m_isLeaf(_isLeaf),
-        m_parent(_parent) {}
+        m_parent(_parent) {
+    reserve_entries();
+  }
 
   // Initialize with vector of children or data
   template <typename T>
     requires DataOrNode<T, MAX_POINTS_PER_NODE>
-  SSNode(const std::vector<std::shared_ptr<T>> &points,
+  SSNode(std::vector<std::shared_ptr<T>> points,
          const std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> &_parent)
       : m_radius(0.0F), m_isLeaf(std::is_same_v<T, Data>), m_parent(_parent) {
 
     if constexpr (std::is_same_v<T, Data>) {
-      m_data = points;
+      m_data = std::move(points);
     } else {
-      m_children = points;
+      m_children = std::move(points);
     }
+    reserve_entries();
     update_bounding_envelope();
   }
 
@@ -73,6 +114,9 @@ public:
     return m_centroid;
   }
   [[nodiscard]] auto get_radius() const -> float { return m_radius; }
+  [[nodiscard]] auto get_id_range() const -> const IdRange & {
+    return m_id_range;
+  }
   auto get_children() const -> const std::vector<std::shared_ptr<SSNode>> & {
     return m_children;
   }
@@ -83,6 +127,11 @@ public:
   [[nodiscard]] auto get_is_leaf() const -> bool { return m_isLeaf; }
   auto get_parent() const -> std::shared_ptr<SSNode> { return m_parent.lock(); }
 
+  // Setters
+  void set_parent(const std::shared_ptr<SSNode> &parent) { m_parent = parent; }
+  // Sets the routing projection of this node only
+  void set_projection(const std::shared_ptr<const Projection> &projection);
+
   // Adders
   void add_child(const std::shared_ptr<SSNode> &child);
   void add_data(const std::shared_ptr<Data> &_data);
@@ -91,6 +140,26 @@ public:
   auto search_parent_leaf(const Point &target) -> std::shared_ptr<SSNode>;
   auto insert(const std::shared_ptr<Data> &data) -> split_t;
   auto search(const Point &target) -> std::shared_ptr<SSNode>;
+
+  // k nearest eligible neighbors of the subtree, merged into `heap`
+  void knn(const Point &target, NeighborHeap &heap,
+           const SearchFilter &filter = {}) const;
+  // Eligible entries of the subtree closer than `radius`, appended unsorted
+  void range(const Point &target, float radius, std::vector<Neighbor> &result,
+             const SearchFilter &filter = {}) const;
+};
+
+// Insert staging: with a non-zero flush_threshold new data lands in a
+// WriteBuffer and is moved into the tree batch_size entries at a time once the
+// threshold is reached. Inline, each insert past the threshold moves one
+// batch. In the background, a flush thread drains the buffer, and an insert
+// that finds max_buffered entries moves one batch itself, so a producer
+// faster than the flush thread is slowed down instead of growing the buffer.
+struct WriteBufferOptions {
+  size_t flush_threshold = 0;
+  size_t batch_size = 64;
+  bool background_flush = false;
+  size_t max_buffered = 0; // 0 = 2 * flush_threshold
 };
 
 template <size_t MAX_POINTS_PER_NODE> class SSTree {
@@ -98,26 +167,65 @@ private:
   using SSNode = SSNode<MAX_POINTS_PER_NODE>;
 
   std::shared_ptr<SSNode> m_root;
+  std::shared_ptr<const Projection> m_projection;
+
+  WriteBufferOptions m_buffer_options;
+  WriteBuffer m_buffer;
+  std::vector<std::shared_ptr<Data>> m_flush_batch;
+
+  // m_tree_mutex guards m_root, m_buffer_mutex guards m_buffer. A flushed
+  // batch leaves the buffer while the tree is still exclusively locked, so
+  // queries, which snapshot the buffer under their shared tree lock, never
+  // miss or duplicate an entry. The snapshot is scanned without any lock.
+  mutable std::shared_mutex m_tree_mutex;
+  mutable std::mutex m_buffer_mutex;
+  std::condition_variable_any m_flush_cv;
+  std::jthread m_flush_thread; // Last member: joined before the rest dies
+
+  void insert_into_tree(const std::shared_ptr<Data> &data);
+  auto flush_batch() -> bool;
+  void flush_worker(const std::stop_token &stop_token);
 
 public:
   SSTree() : m_root(nullptr) {}
+  explicit SSTree(const WriteBufferOptions &buffer_options);
 
+  SSTree(const SSTree &) = delete;
+  auto operator=(const SSTree &) -> SSTree & = delete;
+  SSTree(SSTree &&) = delete;
+  auto operator=(SSTree &&) -> SSTree & = delete;
+  ~SSTree() = default;
+
+  // Projects every node's centroid; later routing uses the cheap bounds.
+  // Train it once, e.g. Projection::pca over a sample of the data.
+  void set_projection(const Projection &projection);
+
+  // Not synchronised with background flushes, call flush() first
   [[nodiscard]] auto get_root() const -> std::shared_ptr<SSNode> {
     return m_root;
   }
+  [[nodiscard]] auto get_buffered_count() const -> size_t;
 
   void insert(const std::shared_ptr<Data> &data);
   auto search(const std::shared_ptr<Data> &data) -> std::shared_ptr<SSNode>;
+  // shared_bound (optional) is shared with searches of other partitions,
+  // see NeighborHeap; the result may then hold fewer than k neighbors
+  auto knn(const Point &target, size_t k, const SearchFilter &filter = {},
+           std::atomic<float> *shared_bound = nullptr) const
+      -> std::vector<Neighbor>;
+  // Every eligible entry closer than `radius`, sorted by distance
+  auto range(const Point &target, float radius,
+             const SearchFilter &filter = {}) const -> std::vector<Neighbor>;
+
+  // Moves every buffered entry into the tree
+  void flush();
 };
 
 // Explicit instantiation
-extern template class SSNode<20>;
-extern template class SSTree<20>;
-
-extern template class SSNode<7>;
-extern template class SSTree<7>;
-
-extern template class SSNode<11>;
-extern template class SSTree<11>;
+#define SSTREE_EXTERN_TEMPLATE(N)                                              \
+  extern template class SSNode<N>;                                             \
+  extern template class SSTree<N>;
+SSTREE_FOR_EACH_CAPACITY(SSTREE_EXTERN_TEMPLATE)
+#undef SSTREE_EXTERN_TEMPLATE
 
 #endif // INCLUDE_SSTREE_HPP_
@@ -0,0 +1,79 @@
+#ifndef INCLUDE_SEARCHFILTER_HPP_
+#define INCLUDE_SEARCHFILTER_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "Data.hpp"
+
+// Dense bitmap over Data ids
+class IdBitmap {
+public:
+  static constexpr uint64_t WORD_BITS = 64;
+
+private:
+  std::vector<uint64_t> m_words;
+
+public:
+  IdBitmap() = default;
+  explicit IdBitmap(uint64_t max_id)
+      : m_words(max_id / WORD_BITS + 1, 0) {}
+
+  void set(uint64_t id);
+  void reset(uint64_t id);
+  [[nodiscard]] auto test(uint64_t id) const -> bool;
+
+  [[nodiscard]] auto get_words() const -> const std::vector<uint64_t> & {
+    return m_words;
+  }
+};
+
+// Smallest and largest id stored below a node; empty while min > max
+struct IdRange {
+  uint64_t min = std::numeric_limits<uint64_t>::max();
+  uint64_t max = 0;
+
+  void include(uint64_t id) {
+    min = std::min(min, id);
+    max = std::max(max, id);
+  }
+  void include(const IdRange &other) {
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+  [[nodiscard]] auto empty() const -> bool { return min > max; }
+};
+
+// Restricts a search to the entries whose id is in the bitmap and/or that
+// satisfy the predicate. Both checks run before any distance is computed.
+class SearchFilter {
+private:
+  std::optional<IdBitmap> m_allowed_ids;
+  std::function<bool(const Data &)> m_predicate;
+  // Allowed ids below each word of the bitmap, plus the total at the end
+  std::vector<uint64_t> m_allowed_before;
+
+  void count_allowed_ids();
+  // Allowed ids in [0, id]
+  [[nodiscard]] auto allowed_through(uint64_t id) const -> uint64_t;
+
+public:
+  // Accepts every entry
+  SearchFilter() = default;
+  explicit SearchFilter(IdBitmap allowed_ids);
+  explicit SearchFilter(std::function<bool(const Data &)> predicate);
+  SearchFilter(IdBitmap allowed_ids,
+               std::function<bool(const Data &)> predicate);
+
+  [[nodiscard]] auto accepts(const Data &data) const -> bool;
+
+  // False when the bitmap allows no id in the range, so a node whose ids
+  // all lie in it can be skipped. Predicates cannot prune nodes.
+  [[nodiscard]] auto may_contain(const IdRange &ids) const -> bool;
+};
+
+#endif // INCLUDE_SEARCHFILTER_HPP_
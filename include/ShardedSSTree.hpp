@@ -0,0 +1,92 @@
+#ifndef INCLUDE_SHARDEDSSTREE_HPP_
+#define INCLUDE_SHARDEDSSTREE_HPP_
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Data.hpp"
+#include "Neighbor.hpp"
+#include "Point.hpp"
+#include "SSTree.hpp"
+#include "SearchFilter.hpp"
+#include "WorkerThread.hpp"
+
+enum class ShardPartitioning {
+  HASH,    // By hash of the image path
+  CLUSTER, // To the shard with the closest trained centroid
+};
+
+struct ShardOptions {
+  size_t num_shards = 4;
+  ShardPartitioning partitioning = ShardPartitioning::HASH;
+  // CPUs of each shard's threads, e.g. the cores of the NUMA node the shard
+  // should live on. Missing or empty entries leave the threads unpinned.
+  std::vector<std::vector<size_t>> shard_cpus;
+  // Threads per shard running kNN, so that many concurrent queries search a
+  // shard in parallel
+  size_t readers_per_shard = 2;
+  WriteBufferOptions buffer_options;
+};
+
+// N independent SSTrees. Each shard has one writer thread that performs all
+// of its allocation (construction, inserts, flushes) and a few reader
+// threads for kNN, all pinned to the same CPUs, so pinning them to a NUMA
+// node keeps the shard's memory and searches on that node. Each insert goes
+// to one shard; kNN runs on every shard in parallel, on the next reader of
+// each, and merges the top k. Readers share the tree's lock, so queries do
+// not wait for each other nor for the queued inserts.
+// The shards share the best k-th distance found so far, so a shard whose
+// candidates are all farther than another shard's k results prunes them.
+template <size_t MAX_POINTS_PER_NODE> class ShardedSSTree {
+private:
+  using Shard = SSTree<MAX_POINTS_PER_NODE>;
+
+  ShardOptions m_options;
+  std::vector<std::unique_ptr<Shard>> m_shards;
+  std::vector<Point> m_shard_centroids; // Only for CLUSTER partitioning
+  // First error of an asynchronous insert, rethrown by flush()
+  std::mutex m_insert_error_mutex;
+  std::exception_ptr m_insert_error;
+  mutable std::atomic<size_t> m_next_reader{0};
+  // Last members: the threads drain their queues before the shards die.
+  // Readers of shard s are m_readers[s * readers_per_shard + r].
+  std::vector<std::unique_ptr<WorkerThread>> m_writers;
+  std::vector<std::unique_ptr<WorkerThread>> m_readers;
+
+  [[nodiscard]] auto shard_for(const Data &data) const -> size_t;
+  void run_on_every_shard(const std::function<void(size_t)> &task) const;
+
+public:
+  explicit ShardedSSTree(const ShardOptions &options = {});
+
+  // Learns one centroid per shard from a sample (k-means). Call it before
+  // inserting, otherwise CLUSTER partitioning falls back to hashing.
+  void train_partitioning(const std::vector<Point> &sample,
+                          size_t iterations = 10);
+
+  // Asynchronous: queued on the shard's writer, errors surface in flush().
+  // kNN sees an insert once the writer has run it.
+  void insert(const std::shared_ptr<Data> &data);
+  auto knn(const Point &target, size_t k,
+           const SearchFilter &filter = {}) const -> std::vector<Neighbor>;
+  void flush();
+
+  [[nodiscard]] auto get_num_shards() const -> size_t {
+    return m_shards.size();
+  }
+  // May miss queued inserts, call flush() first
+  [[nodiscard]] auto get_shard(size_t index) const -> const Shard & {
+    return *m_shards.at(index);
+  }
+};
+
+// Explicit instantiation
+#define SSTREE_EXTERN_SHARDED(N) extern template class ShardedSSTree<N>;
+SSTREE_FOR_EACH_CAPACITY(SSTREE_EXTERN_SHARDED)
+#undef SSTREE_EXTERN_SHARDED
+
+#endif // INCLUDE_SHARDEDSSTREE_HPP_
@@ -0,0 +1,105 @@
+#ifndef INCLUDE_TIEREDSSTREE_HPP_
+#define INCLUDE_TIEREDSSTREE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BufferPool.hpp"
+#include "Neighbor.hpp"
+#include "Point.hpp"
+#include "SSTree.hpp"
+
+struct TieredBuildOptions {
+  // Points are routed to the closest of these k-means centroids, and each
+  // cluster fills its own leaves
+  size_t num_clusters = 64;
+  size_t sample_size = 10000; // First points of the dataset, for k-means
+  size_t kmeans_iterations = 10;
+  size_t chunk_size = 4096; // Points read from the dataset at a time
+  size_t prefetch_depth = 4;
+};
+
+// Read-only SSTree whose leaf embeddings live in a page file on disk.
+// Centroids, radii and leaf metadata stay in memory; each leaf's embedding
+// block is one page loaded through a fixed-size BufferPool, so memory is
+// bounded by the pool size. kNN prefetches the next frontier leaves while it
+// scans the current one.
+// The in-memory part is saved next to the page file (metadata_path), so an
+// index built once can be reopened with open().
+template <size_t MAX_POINTS_PER_NODE> class TieredSSTree {
+private:
+  struct Node {
+    Point centroid;
+    float radius = 0.0F;
+    std::vector<size_t> children; // Indices into m_nodes, empty for leaves
+    // Distance of each entry (embedding or child centroid) to the centroid
+    std::vector<float> entry_distances;
+    // Leaves only: page with the embeddings and the metadata of each entry
+    uint64_t page_id = 0;
+    std::vector<std::string> paths;
+    std::vector<uint64_t> ids;
+
+    [[nodiscard]] auto is_leaf() const -> bool { return children.empty(); }
+  };
+
+  std::vector<Node> m_nodes;
+  size_t m_root = 0; // Index of the root in m_nodes
+  size_t m_num_leaves = 0;
+  std::string m_page_file_path;
+  PageFile m_page_file;
+  mutable BufferPool m_pool;
+  size_t m_prefetch_depth;
+
+  TieredSSTree(const std::string &page_file_path, PageFileMode mode,
+               size_t pool_frames, size_t prefetch_depth);
+
+  auto copy_subtree(const std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> &node,
+                    std::vector<float> &page) -> size_t;
+  // `page` holds `paths.size()` rows and is padded with zeros to a full page
+  auto add_leaf(std::vector<float> &page, std::vector<std::string> paths,
+                std::vector<uint64_t> ids) -> size_t;
+  auto add_internal(std::vector<size_t> children) -> size_t;
+  void save_metadata();
+  void load_metadata();
+
+public:
+  // Flushes `tree` and writes its leaves to `page_file_path`
+  TieredSSTree(SSTree<MAX_POINTS_PER_NODE> &tree,
+               const std::string &page_file_path, size_t pool_frames,
+               size_t prefetch_depth = 4);
+
+  TieredSSTree(const TieredSSTree &) = delete;
+  auto operator=(const TieredSSTree &) -> TieredSSTree & = delete;
+  TieredSSTree(TieredSSTree &&) = delete;
+  auto operator=(TieredSSTree &&) -> TieredSSTree & = delete;
+  ~TieredSSTree() = default;
+
+  // Bulk-loads a Dataset file without reading it whole: only the k-means
+  // sample, one chunk and one open leaf per cluster are in memory at a time
+  static auto build(const std::string &dataset_path,
+                    const std::string &page_file_path, size_t pool_frames,
+                    const TieredBuildOptions &options = {})
+      -> std::unique_ptr<TieredSSTree>;
+  // Reopens an index written by build() or the SSTree constructor
+  static auto open(const std::string &page_file_path, size_t pool_frames,
+                   size_t prefetch_depth = 4) -> std::unique_ptr<TieredSSTree>;
+  static auto metadata_path(const std::string &page_file_path) -> std::string {
+    return page_file_path + ".meta";
+  }
+
+  auto knn(const Point &target, size_t k) const -> std::vector<Neighbor>;
+
+  [[nodiscard]] auto get_num_leaves() const -> size_t { return m_num_leaves; }
+  [[nodiscard]] auto get_pool_stats() const -> BufferPoolStats {
+    return m_pool.get_stats();
+  }
+};
+
+// Explicit instantiation
+#define SSTREE_EXTERN_TIERED(N) extern template class TieredSSTree<N>;
+SSTREE_FOR_EACH_CAPACITY(SSTREE_EXTERN_TIERED)
+#undef SSTREE_EXTERN_TIERED
+
+#endif // INCLUDE_TIEREDSSTREE_HPP_
@@ -0,0 +1,35 @@
+#ifndef INCLUDE_WORKERTHREAD_HPP_
+#define INCLUDE_WORKERTHREAD_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Single thread running posted tasks in order, optionally restricted to a set
+// of CPUs (e.g. the cores of one NUMA node)
+class WorkerThread {
+private:
+  std::mutex m_mutex;
+  std::deque<std::function<void()>> m_tasks;
+  std::condition_variable_any m_tasks_cv;
+  std::jthread m_thread; // Last member: joined before the rest dies
+
+  void run(const std::stop_token &stop_token);
+
+public:
+  // An empty cpu list leaves the thread unpinned
+  explicit WorkerThread(const std::vector<size_t> &cpus = {});
+
+  WorkerThread(const WorkerThread &) = delete;
+  auto operator=(const WorkerThread &) -> WorkerThread & = delete;
+  WorkerThread(WorkerThread &&) = delete;
+  auto operator=(WorkerThread &&) -> WorkerThread & = delete;
+  ~WorkerThread() = default;
+
+  void post(std::function<void()> task);
+};
+
+#endif // INCLUDE_WORKERTHREAD_HPP_
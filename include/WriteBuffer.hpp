@@ -0,0 +1,72 @@
+#ifndef INCLUDE_WRITEBUFFER_HPP_
+#define INCLUDE_WRITEBUFFER_HPP_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "Data.hpp"
+#include "Neighbor.hpp"
+#include "Point.hpp"
+#include "SearchFilter.hpp"
+
+// Append-only staging area for freshly inserted data.
+// Embeddings are copied into fixed-size chunks, each one contiguous and
+// row-major, so queries can brute-force scan them with the SIMD distance
+// kernel. A slot is written once and never moves: flushed entries are dropped
+// by advancing m_head, and a chunk is released once all of its entries are
+// flushed. A snapshot therefore stays valid, and can be scanned without the
+// buffer's lock, while appends and flushes go on.
+class WriteBuffer {
+public:
+  static constexpr size_t CHUNK_SIZE = 64;
+
+private:
+  struct Chunk {
+    std::array<float, CHUNK_SIZE * DIM> embeddings;
+    std::array<std::shared_ptr<Data>, CHUNK_SIZE> data;
+  };
+
+  std::vector<std::shared_ptr<Chunk>> m_chunks;
+  size_t m_head = 0; // Oldest live entry, as a slot of m_chunks.front()
+  size_t m_size = 0;
+
+public:
+  // Live entries at the time it was taken
+  class Snapshot {
+  private:
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    size_t m_head = 0;
+    size_t m_size = 0;
+
+    friend class WriteBuffer;
+
+  public:
+    [[nodiscard]] auto size() const -> size_t { return m_size; }
+
+    // Brute-force scan, pushing every eligible buffered entry into `heap`
+    void knn(const Point &target, NeighborHeap &heap,
+             const SearchFilter &filter = {}) const;
+    // Brute-force scan, appending every eligible entry closer than `radius`
+    void range(const Point &target, float radius,
+               std::vector<Neighbor> &result,
+               const SearchFilter &filter = {}) const;
+  };
+
+  WriteBuffer() = default;
+
+  [[nodiscard]] auto size() const -> size_t { return m_size; }
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+
+  void append(const std::shared_ptr<Data> &data);
+
+  // Replaces `out` with the oldest `count` entries (or all, if fewer)
+  void copy_front(size_t count, std::vector<std::shared_ptr<Data>> &out) const;
+  // Removes the oldest `count` entries (the ones already flushed to the tree).
+  // Their references are released with their chunk.
+  void erase_front(size_t count);
+
+  [[nodiscard]] auto snapshot() const -> Snapshot;
+};
+
+#endif // INCLUDE_WRITEBUFFER_HPP_
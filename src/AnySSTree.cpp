@@ -0,0 +1,27 @@
+#include "AnySSTree.hpp"
+
+#include <stdexcept>
+#include <string>
+
+/**
+ * makeSSTree
+ * Crea un SSTree con la capacidad de nodo pedida.
+ * @param max_points_per_node Capacidad de cada nodo, una de
+ * SUPPORTED_CAPACITIES.
+ * @param buffer_options Opciones del buffer de escritura.
+ * @return std::unique_ptr<AnySSTree>: Árbol vacío.
+ */
+auto make_sstree(size_t max_points_per_node,
+                 const WriteBufferOptions &buffer_options)
+    -> std::unique_ptr<AnySSTree> {
+  switch (max_points_per_node) {
+#define SSTREE_MAKE_CASE(N)                                                    \
+  case N:                                                                      \
+    return std::make_unique<SSTreeAdapter<N>>(buffer_options);
+    SSTREE_FOR_EACH_CAPACITY(SSTREE_MAKE_CASE)
+#undef SSTREE_MAKE_CASE
+  default:
+    throw std::invalid_argument("Unsupported node capacity: " +
+                                std::to_string(max_points_per_node));
+  }
+}
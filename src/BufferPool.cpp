@@ -0,0 +1,232 @@
+#include "BufferPool.hpp"
+
+#include <stdexcept>
+
+PageFile::PageFile(const std::string &path, size_t page_floats,
+                   PageFileMode mode)
+    : m_page_floats(page_floats),
+      m_file(path, std::ios::in | std::ios::out | std::ios::binary |
+                       (mode == PageFileMode::CREATE ? std::ios::trunc
+                                                     : std::ios::openmode{})) {
+  if (!m_file) {
+    throw std::runtime_error("Cannot open page file: " + path);
+  }
+}
+
+/**
+ * writePage
+ * Escribe una página completa en su posición del archivo.
+ * @param page_id Número de página.
+ * @param data page_floats floats a escribir.
+ */
+void PageFile::write_page(uint64_t page_id, const float *data) {
+  auto page_bytes = m_page_floats * sizeof(float);
+  std::scoped_lock lock(m_mutex);
+  m_file.clear();
+  m_file.seekp(static_cast<std::streamoff>(page_id * page_bytes));
+  m_file.write(reinterpret_cast<const char *>(data),
+               static_cast<std::streamsize>(page_bytes));
+  if (!m_file) {
+    throw std::runtime_error("Cannot write page " + std::to_string(page_id));
+  }
+}
+
+/**
+ * flush
+ * Envía al archivo las páginas escritas que siguen en el buffer del stream.
+ * Se llama una vez al terminar de escribir, no después de cada página.
+ */
+void PageFile::flush() {
+  std::scoped_lock lock(m_mutex);
+  m_file.flush();
+  if (!m_file) {
+    throw std::runtime_error("Cannot flush page file");
+  }
+}
+
+/**
+ * readPage
+ * Lee una página completa del archivo.
+ * @param page_id Número de página.
+ * @param data Destino de page_floats floats.
+ */
+void PageFile::read_page(uint64_t page_id, float *data) const {
+  auto page_bytes = m_page_floats * sizeof(float);
+  std::scoped_lock lock(m_mutex);
+  m_file.clear();
+  m_file.seekg(static_cast<std::streamoff>(page_id * page_bytes));
+  m_file.read(reinterpret_cast<char *>(data),
+              static_cast<std::streamsize>(page_bytes));
+  if (!m_file) {
+    throw std::runtime_error("Cannot read page " + std::to_string(page_id));
+  }
+}
+
+BufferPool::BufferPool(const PageFile &file, size_t num_frames)
+    : m_file(file), m_frame_data(num_frames * file.get_page_floats()),
+      m_frames(num_frames) {
+  if (num_frames == 0) {
+    throw std::invalid_argument("A buffer pool needs at least one frame");
+  }
+  m_prefetch_thread = std::jthread(
+      [this](const std::stop_token &stop_token) { prefetch_worker(stop_token); });
+}
+
+/**
+ * findVictim
+ * Algoritmo CLOCK: recorre los marcos desde la manecilla, dando una segunda
+ * oportunidad a los marcos referenciados y saltando los fijados.
+ * @return std::optional<size_t>: Marco libre o reemplazable, si existe.
+ */
+auto BufferPool::find_victim() -> std::optional<size_t> {
+  for (size_t step = 0; step < 2 * m_frames.size(); ++step) {
+    auto index = m_clock_hand;
+    m_clock_hand = (m_clock_hand + 1) % m_frames.size();
+
+    auto &frame = m_frames[index];
+    if (frame.pin_count > 0) {
+      continue;
+    }
+    if (frame.state == FrameState::EMPTY || !frame.referenced) {
+      return index;
+    }
+    frame.referenced = false;
+  }
+  return std::nullopt;
+}
+
+/**
+ * load
+ * Devuelve el marco que contiene la página, fijado. Si la página no está en
+ * memoria se lee del archivo sin mantener el lock. Quien espera una lectura
+ * ajena comprueba al despertar que el marco contiene su página; si esa
+ * lectura falló, vuelve a intentarla.
+ * @param lock Lock del pool (tomado).
+ * @param page_id Página a cargar.
+ * @param wait_for_frame Esperar si todos los marcos están fijados.
+ * @return std::optional<size_t>: Marco fijado, o nullopt si no hubo marco.
+ */
+auto BufferPool::load(std::unique_lock<std::mutex> &lock, uint64_t page_id,
+                      bool wait_for_frame) -> std::optional<size_t> {
+  while (true) {
+    if (auto entry = m_page_table.find(page_id); entry != m_page_table.end()) {
+      auto index = entry->second;
+      ++m_frames[index].pin_count;
+      m_frames[index].referenced = true;
+      ++m_stats.hits;
+      m_frame_cv.wait(lock, [&] {
+        return m_frames[index].state != FrameState::LOADING;
+      });
+      if (m_frames[index].page_id == page_id &&
+          m_frames[index].state == FrameState::READY) {
+        return index;
+      }
+      // The read of the thread that was loading it failed, and the frame may
+      // hold another page by now: drop the pin and load the page again
+      if (--m_frames[index].pin_count == 0) {
+        m_frame_cv.notify_all();
+      }
+      continue;
+    }
+
+    auto victim = find_victim();
+    if (!victim) {
+      if (!wait_for_frame) {
+        return std::nullopt;
+      }
+      m_frame_cv.wait(lock);
+      continue;
+    }
+
+    auto &frame = m_frames[*victim];
+    if (frame.state == FrameState::READY) {
+      m_page_table.erase(frame.page_id);
+      ++m_stats.evictions;
+    }
+    frame = {.page_id = page_id,
+             .pin_count = 1,
+             .referenced = true,
+             .state = FrameState::LOADING};
+    m_page_table[page_id] = *victim;
+    ++m_stats.misses;
+
+    lock.unlock();
+    try {
+      m_file.read_page(page_id, m_frame_data.data() +
+                                    *victim * m_file.get_page_floats());
+    } catch (...) {
+      lock.lock();
+      m_page_table.erase(page_id);
+      // Threads waiting on the frame keep their pins until they wake up
+      auto &failed = m_frames[*victim];
+      --failed.pin_count;
+      failed.referenced = false;
+      failed.state = FrameState::EMPTY;
+      m_frame_cv.notify_all();
+      throw;
+    }
+    lock.lock();
+
+    m_frames[*victim].state = FrameState::READY;
+    m_frame_cv.notify_all();
+    return victim;
+  }
+}
+
+void BufferPool::unpin(size_t frame) {
+  std::scoped_lock lock(m_mutex);
+  if (--m_frames[frame].pin_count == 0) {
+    m_frame_cv.notify_all();
+  }
+}
+
+auto BufferPool::pin(uint64_t page_id) -> PageHandle {
+  std::unique_lock lock(m_mutex);
+  return {this, *load(lock, page_id, true)};
+}
+
+void BufferPool::prefetch(uint64_t page_id) {
+  {
+    std::scoped_lock lock(m_mutex);
+    if (m_page_table.contains(page_id) ||
+        m_prefetch_queue.size() >= m_frames.size()) {
+      return;
+    }
+    m_prefetch_queue.push_back(page_id);
+  }
+  m_prefetch_cv.notify_one();
+}
+
+/**
+ * prefetchWorker
+ * Hilo de fondo que carga las páginas pedidas con prefetch. Si todos los
+ * marcos están fijados la petición se descarta.
+ * @param stop_token Señal de parada enviada al destruir el pool.
+ */
+void BufferPool::prefetch_worker(const std::stop_token &stop_token) {
+  std::unique_lock lock(m_mutex);
+  while (m_prefetch_cv.wait(lock, stop_token,
+                            [this] { return !m_prefetch_queue.empty(); })) {
+    auto page_id = m_prefetch_queue.front();
+    m_prefetch_queue.pop_front();
+    if (m_page_table.contains(page_id)) {
+      continue;
+    }
+
+    try {
+      if (auto frame = load(lock, page_id, false)) {
+        ++m_stats.prefetches;
+        if (--m_frames[*frame].pin_count == 0) {
+          m_frame_cv.notify_all();
+        }
+      }
+    } catch (const std::runtime_error &) {
+      // A failed prefetch is retried (and reported) by the next pin()
+    }
+  }
+}
+
+auto BufferPool::get_stats() const -> BufferPoolStats {
+  std::scoped_lock lock(m_mutex);
+  return m_stats;
+}
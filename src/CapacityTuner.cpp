@@ -0,0 +1,102 @@
+#include "CapacityTuner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * kthDistances
+ * Distancia del k-ésimo vecino de cada consulta, por fuerza bruta.
+ * @param sample Datos indexados.
+ * @param queries Puntos de consulta.
+ * @param k Número de vecinos.
+ * @return std::vector<float>: Una distancia por consulta.
+ */
+auto kth_distances(const std::vector<std::shared_ptr<Data>> &sample,
+                   const std::vector<Point> &queries, size_t k)
+    -> std::vector<float> {
+  std::vector<float> kth;
+  std::vector<float> distances(sample.size());
+  for (const auto &query : queries) {
+    std::ranges::transform(sample, distances.begin(),
+                           [&query](const auto &data) {
+                             return Point::distance(query,
+                                                    data->get_embedding());
+                           });
+    auto nth = distances.begin() + static_cast<int64_t>(k - 1);
+    std::ranges::nth_element(distances, nth);
+    kth.push_back(*nth);
+  }
+  return kth;
+}
+
+} // namespace
+
+/**
+ * tuneCapacity
+ * Prueba cada capacidad candidata sobre la muestra y elige la de menor
+ * latencia media entre las que alcanzan el recall pedido.
+ * @param sample Datos con los que se construye cada árbol de prueba.
+ * @param queries Consultas usadas para medir latencia y recall.
+ * @param options Candidatos, k, recall objetivo y repeticiones.
+ * @return TuningResult: Capacidad elegida y medidas de cada candidato.
+ */
+auto tune_capacity(const std::vector<std::shared_ptr<Data>> &sample,
+                   const std::vector<Point> &queries,
+                   const TuningOptions &options) -> TuningResult {
+  if (options.k == 0 || options.k > sample.size() || queries.empty()) {
+    throw std::invalid_argument(
+        "Tuning needs queries and at least k sample points");
+  }
+  auto kth = kth_distances(sample, queries, options.k);
+  // Ties and float rounding must not count as misses
+  constexpr float DISTANCE_TOLERANCE = 1e-4F;
+
+  TuningResult result{.max_points_per_node = 0, .trials = {}};
+  auto best_latency = std::numeric_limits<double>::max();
+
+  for (auto capacity : options.candidates) {
+    auto tree = make_sstree(capacity);
+    for (const auto &data : sample) {
+      tree->insert(data);
+    }
+
+    size_t hits = 0;
+    auto fastest = std::chrono::steady_clock::duration::max();
+    for (size_t run = 0; run < std::max<size_t>(options.repetitions, 1);
+         ++run) {
+      size_t run_hits = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < queries.size(); ++i) {
+        for (const auto &neighbor : tree->knn(queries[i], options.k, {})) {
+          run_hits += neighbor.distance <= kth[i] + DISTANCE_TOLERANCE ? 1 : 0;
+        }
+      }
+      fastest = std::min(fastest, std::chrono::steady_clock::now() - start);
+      hits = run_hits;
+    }
+
+    CapacityTrial trial{
+        .max_points_per_node = capacity,
+        .recall = static_cast<float>(hits) /
+                  static_cast<float>(queries.size() * options.k),
+        .mean_latency_us =
+            std::chrono::duration<double, std::micro>(fastest).count() /
+            static_cast<double>(queries.size())};
+    result.trials.push_back(trial);
+
+    if (trial.recall >= options.target_recall &&
+        trial.mean_latency_us < best_latency) {
+      best_latency = trial.mean_latency_us;
+      result.max_points_per_node = capacity;
+    }
+  }
+
+  if (result.max_points_per_node == 0) {
+    throw std::runtime_error("No capacity reaches the target recall");
+  }
+  return result;
+}
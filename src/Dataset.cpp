@@ -0,0 +1,245 @@
+#include "Dataset.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <numbers>
+#include <stdexcept>
+#include <thread>
+
+constexpr uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+// Streams at or above this value hold the mixture centers, the rest are points
+constexpr uint64_t CENTER_STREAM = uint64_t{1} << 63U;
+constexpr std::array<char, 4> FILE_MAGIC = {'S', 'S', 'T', 'D'};
+constexpr uint64_t FILE_VERSION = 1;
+
+namespace {
+
+auto splitmix64(uint64_t value) -> uint64_t {
+  value += GOLDEN_GAMMA;
+  value = (value ^ (value >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27U)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31U);
+}
+
+/**
+ * generatePoint
+ * Genera las coordenadas de un punto a partir de su propio flujo aleatorio.
+ * @param options Parámetros de la distribución.
+ * @param centers Centros de la mezcla gaussiana (fila por centro).
+ * @param index Índice del punto (flujo del generador).
+ * @param row Destino de las DIM coordenadas.
+ */
+void generate_point(const DatasetOptions &options,
+                    const std::vector<float> &centers, uint64_t index,
+                    float *row) {
+  CounterRng rng(options.seed, index);
+
+  switch (options.distribution) {
+  case Distribution::UNIFORM:
+    for (size_t i = 0; i < DIM; ++i) {
+      row[i] = options.min + (options.max - options.min) * rng.uniform();
+    }
+    break;
+
+  case Distribution::GAUSSIAN_MIXTURE: {
+    auto cluster = static_cast<size_t>(rng.next() % options.num_clusters);
+    const float *center = centers.data() + cluster * DIM;
+    for (size_t i = 0; i < DIM; ++i) {
+      row[i] = center[i] + options.spread * rng.normal();
+    }
+    break;
+  }
+
+  case Distribution::ANISOTROPIC: {
+    float middle = (options.min + options.max) / 2.0F;
+    for (size_t i = 0; i < DIM; ++i) {
+      float spread =
+          options.spread *
+          std::pow(static_cast<float>(i + 1), -options.decay);
+      row[i] = middle + spread * rng.normal();
+    }
+    break;
+  }
+  }
+}
+
+} // namespace
+
+CounterRng::CounterRng(uint64_t seed, uint64_t stream)
+    : m_key(splitmix64(seed ^ splitmix64(stream))) {}
+
+auto CounterRng::next() -> uint64_t {
+  return splitmix64(m_key + GOLDEN_GAMMA * m_counter++);
+}
+
+auto CounterRng::uniform() -> float {
+  constexpr float SCALE = 1.0F / static_cast<float>(uint64_t{1} << 24U);
+  return static_cast<float>(next() >> 40U) * SCALE;
+}
+
+auto CounterRng::normal() -> float {
+  // 1 - uniform() is in (0, 1], so the logarithm is finite
+  float radius = std::sqrt(-2.0F * std::log(1.0F - uniform()));
+  return radius * std::cos(2.0F * std::numbers::pi_v<float> * uniform());
+}
+
+/**
+ * generate
+ * Genera un conjunto de datos sintético en paralelo. Cada punto usa su propio
+ * flujo del generador, por lo que el resultado solo depende de la semilla y
+ * no del número de hilos.
+ * @param options Parámetros del conjunto de datos.
+ * @return Dataset: Conjunto de datos generado.
+ */
+auto Dataset::generate(const DatasetOptions &options) -> Dataset {
+  if (options.distribution == Distribution::GAUSSIAN_MIXTURE &&
+      options.num_clusters == 0) {
+    throw std::invalid_argument("A gaussian mixture needs at least a cluster");
+  }
+
+  std::vector<float> centers;
+  if (options.distribution == Distribution::GAUSSIAN_MIXTURE) {
+    centers.resize(options.num_clusters * DIM);
+    for (size_t cluster = 0; cluster < options.num_clusters; ++cluster) {
+      CounterRng rng(options.seed, CENTER_STREAM + cluster);
+      std::ranges::generate_n(
+          centers.begin() + static_cast<int64_t>(cluster * DIM), DIM, [&]() {
+            return options.min + (options.max - options.min) * rng.uniform();
+          });
+    }
+  }
+
+  Dataset dataset;
+  dataset.m_embeddings.resize(options.num_points * DIM);
+  if (options.num_points == 0) {
+    return dataset;
+  }
+
+  auto num_threads = options.num_threads != 0
+                         ? options.num_threads
+                         : std::max(1U, std::thread::hardware_concurrency());
+  num_threads = std::clamp<size_t>(num_threads, 1, options.num_points);
+  auto chunk = (options.num_points + num_threads - 1) / num_threads;
+
+  {
+    std::vector<std::jthread> workers;
+    for (size_t begin = 0; begin < options.num_points; begin += chunk) {
+      auto end = std::min(begin + chunk, options.num_points);
+      workers.emplace_back([&, begin, end]() {
+        for (size_t index = begin; index < end; ++index) {
+          generate_point(options, centers, options.first_index + index,
+                         dataset.m_embeddings.data() + index * DIM);
+        }
+      });
+    }
+  }
+
+  return dataset;
+}
+
+/**
+ * save
+ * Escribe el conjunto de datos en un archivo binario:
+ * magic, versión, número de puntos, dimensión y las coordenadas.
+ * @param path Ruta del archivo.
+ */
+void Dataset::save(const std::string &path) const {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open dataset file for writing: " + path);
+  }
+
+  const uint64_t header[] = {FILE_VERSION, size(), DIM};
+  file.write(FILE_MAGIC.data(), FILE_MAGIC.size());
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(m_embeddings.data()),
+             static_cast<std::streamsize>(m_embeddings.size() * sizeof(float)));
+
+  if (!file) {
+    throw std::runtime_error("Cannot write dataset file: " + path);
+  }
+}
+
+/**
+ * load
+ * Lee un conjunto de datos escrito por save.
+ * @param path Ruta del archivo.
+ * @return Dataset: Conjunto de datos leído.
+ */
+auto Dataset::load(const std::string &path) -> Dataset {
+  DatasetReader reader(path);
+  Dataset dataset;
+  reader.read(reader.size(), dataset.m_embeddings);
+  return dataset;
+}
+
+auto Dataset::get_point(size_t index) const -> Point {
+  if (index >= size()) {
+    throw std::out_of_range("Index out of range");
+  }
+  std::array<float, DIM> coordinates{};
+  std::copy_n(m_embeddings.begin() + static_cast<int64_t>(index * DIM), DIM,
+              coordinates.begin());
+  return Point(coordinates);
+}
+
+auto Dataset::to_data() const -> std::vector<std::shared_ptr<Data>> {
+  std::vector<std::shared_ptr<Data>> data;
+  data.reserve(size());
+  for (size_t i = 0; i < size(); ++i) {
+    data.push_back(std::make_shared<Data>(get_point(i), point_path(i), i));
+  }
+  return data;
+}
+
+auto Dataset::point_path(size_t index) -> std::string {
+  return "image_" + std::to_string(index) + ".jpg";
+}
+
+DatasetReader::DatasetReader(const std::string &path)
+    : m_file(path, std::ios::binary), m_path(path) {
+  if (!m_file) {
+    throw std::runtime_error("Cannot open dataset file: " + path);
+  }
+
+  std::array<char, FILE_MAGIC.size()> magic{};
+  uint64_t header[3] = {};
+  m_file.read(magic.data(), magic.size());
+  m_file.read(reinterpret_cast<char *>(header), sizeof(header));
+
+  if (!m_file || magic != FILE_MAGIC || header[0] != FILE_VERSION ||
+      header[2] != DIM) {
+    throw std::runtime_error("Invalid dataset file: " + path);
+  }
+  m_size = header[1];
+}
+
+/**
+ * read
+ * Lee los siguientes puntos del archivo.
+ * @param max_points Máximo de puntos a leer.
+ * @param embeddings Destino, reemplazado por las filas leídas.
+ * @return size_t: Número de puntos leídos.
+ */
+auto DatasetReader::read(size_t max_points, std::vector<float> &embeddings)
+    -> size_t {
+  auto count = std::min(max_points, m_size - m_next);
+  embeddings.resize(count * DIM);
+  m_file.read(reinterpret_cast<char *>(embeddings.data()),
+              static_cast<std::streamsize>(embeddings.size() * sizeof(float)));
+  if (!m_file) {
+    throw std::runtime_error("Truncated dataset file: " + m_path);
+  }
+  m_next += count;
+  return count;
+}
+
+void DatasetReader::rewind() {
+  constexpr auto HEADER_SIZE =
+      static_cast<std::streamoff>(FILE_MAGIC.size() + 3 * sizeof(uint64_t));
+  m_file.clear();
+  m_file.seekg(HEADER_SIZE);
+  m_next = 0;
+}
@@ -0,0 +1,55 @@
+#include "KMeans.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * kmeans
+ * Agrupa la muestra en k grupos (algoritmo de Lloyd). Los centroides iniciales
+ * son puntos de la muestra espaciados uniformemente.
+ * @param sample Puntos de entrenamiento (al menos k).
+ * @param k Número de centroides.
+ * @param iterations Iteraciones de asignación y promedio.
+ * @return std::vector<Point>: Los k centroides.
+ */
+auto kmeans(const std::vector<Point> &sample, size_t k, size_t iterations)
+    -> std::vector<Point> {
+  if (k == 0 || sample.size() < k) {
+    throw std::invalid_argument("k-means needs at least k sample points");
+  }
+
+  std::vector<Point> centroids;
+  for (size_t cluster = 0; cluster < k; ++cluster) {
+    centroids.push_back(sample[cluster * sample.size() / k]);
+  }
+
+  std::vector<Point> sums(k);
+  std::vector<size_t> counts(k);
+  for (size_t iteration = 0; iteration < iterations; ++iteration) {
+    std::ranges::fill(sums, Point());
+    std::ranges::fill(counts, 0);
+
+    for (const auto &point : sample) {
+      auto closest = nearest_centroid(centroids, point);
+      sums[closest] += point;
+      ++counts[closest];
+    }
+
+    // An empty cluster keeps its previous centroid
+    for (size_t cluster = 0; cluster < k; ++cluster) {
+      if (counts[cluster] > 0) {
+        centroids[cluster] = sums[cluster] / static_cast<float>(counts[cluster]);
+      }
+    }
+  }
+  return centroids;
+}
+
+auto nearest_centroid(const std::vector<Point> &centroids, const Point &point)
+    -> size_t {
+  auto closest =
+      std::ranges::min_element(centroids, {}, [&point](const Point &centroid) {
+        return Point::squared_distance(centroid.data(), point.data());
+      });
+  return static_cast<size_t>(closest - centroids.begin());
+}
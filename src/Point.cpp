@@ -6,6 +6,10 @@
 // float comparison error margin
 constexpr float EPSILON = 1e-5F;
 constexpr size_t MM256_VEC_SIZE = 8;
+static_assert(DISTANCE_BLOCK % (2 * MM256_VEC_SIZE) == 0);
+
+// Two adds per call, not per block
+thread_local DistanceWork distance_work_counter;
 
 Point::Point(const std::array<float, DIM> &_coordinates)
     : m_coordinates(_coordinates) {}
@@ -89,7 +93,8 @@ auto Point::operator==(const Point &other) const -> bool {
 auto Point::norm() const -> float {
   __m256 vsum = _mm256_setzero_ps();
 
-  for (size_t i = 0; i + MM256_VEC_SIZE - 1 < DIM; i += MM256_VEC_SIZE) {
+  size_t i = 0;
+  for (; i + MM256_VEC_SIZE - 1 < DIM; i += MM256_VEC_SIZE) {
     __m256 vcoords = _mm256_loadu_ps(&m_coordinates.at(i));
     vsum = _mm256_add_ps(vsum, _mm256_mul_ps(vcoords, vcoords));
   }
@@ -100,8 +105,9 @@ auto Point::norm() const -> float {
   float sum = 0.0F;
   sum = std::accumulate(buffer.begin(), buffer.end(), 0.0F);
 
-  std::ranges::for_each(m_coordinates,
-                        [&sum](float coord) { sum += coord * coord; });
+  for (; i < DIM; ++i) {
+    sum += m_coordinates.at(i) * m_coordinates.at(i);
+  }
 
   return std::sqrt(sum);
 }
@@ -121,8 +127,8 @@ auto Point::operator[](std::size_t index) -> float & {
 }
 
 auto Point::random(float min, float max) -> Point {
-  std::random_device random_device;
-  std::mt19937 gen(random_device());
+  // Seeded once per thread; use Dataset for reproducible data
+  thread_local std::mt19937 gen(std::random_device{}());
   std::uniform_real_distribution<float> dis(min, max);
 
   std::array<float, DIM> coordinates{};
@@ -131,13 +137,13 @@ auto Point::random(float min, float max) -> Point {
   return Point(coordinates);
 }
 
-auto Point::distance(const Point &point1, const Point &point2) -> float {
-  float sum = 0.0F;
+auto Point::squared_distance(const float *lhs, const float *rhs) -> float {
   __m256 vsum = _mm256_setzero_ps();
 
-  for (size_t i = 0; i + MM256_VEC_SIZE - 1 < DIM; i += MM256_VEC_SIZE) {
-    __m256 vcoords1 = _mm256_loadu_ps(&point1.m_coordinates.at(i));
-    __m256 vcoords2 = _mm256_loadu_ps(&point2.m_coordinates.at(i));
+  size_t i = 0;
+  for (; i + MM256_VEC_SIZE - 1 < DIM; i += MM256_VEC_SIZE) {
+    __m256 vcoords1 = _mm256_loadu_ps(lhs + i);
+    __m256 vcoords2 = _mm256_loadu_ps(rhs + i);
     __m256 vdiff = _mm256_sub_ps(vcoords1, vcoords2);
     vsum = _mm256_add_ps(vsum, _mm256_mul_ps(vdiff, vdiff));
   }
@@ -147,12 +153,53 @@ auto Point::distance(const Point &point1, const Point &point2) -> float {
 
   _mm256_storeu_ps(buffer.data(), vsum);
 
-  sum = std::accumulate(buffer.begin(), buffer.end(), 0.0F);
+  float sum = std::accumulate(buffer.begin(), buffer.end(), 0.0F);
 
-  // Reducción
-  for (size_t i = 0; i < DIM; ++i) {
-    float diff = point1.m_coordinates.at(i) - point2.m_coordinates.at(i);
+  // Reducción de las coordenadas que no completan un registro
+  for (; i < DIM; ++i) {
+    float diff = lhs[i] - rhs[i];
     sum += diff * diff;
   }
-  return std::sqrt(sum);
+  return sum;
+}
+
+auto Point::block_squared_distance(const float *lhs, const float *rhs,
+                                   size_t block) -> float {
+  lhs += block * DISTANCE_BLOCK;
+  rhs += block * DISTANCE_BLOCK;
+
+  // Two accumulators hide the latency of the dependent adds
+  __m256 vsum1 = _mm256_setzero_ps();
+  __m256 vsum2 = _mm256_setzero_ps();
+  for (size_t i = 0; i < DISTANCE_BLOCK; i += 2 * MM256_VEC_SIZE) {
+    __m256 vdiff1 =
+        _mm256_sub_ps(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i));
+    __m256 vdiff2 = _mm256_sub_ps(_mm256_loadu_ps(lhs + i + MM256_VEC_SIZE),
+                                  _mm256_loadu_ps(rhs + i + MM256_VEC_SIZE));
+    vsum1 = _mm256_add_ps(vsum1, _mm256_mul_ps(vdiff1, vdiff1));
+    vsum2 = _mm256_add_ps(vsum2, _mm256_mul_ps(vdiff2, vdiff2));
+  }
+
+  std::array<float, MM256_VEC_SIZE> buffer{};
+  _mm256_storeu_ps(buffer.data(), _mm256_add_ps(vsum1, vsum2));
+  return std::accumulate(buffer.begin(), buffer.end(), 0.0F);
+}
+
+auto Point::bounded_squared_distance(const float *lhs, const float *rhs,
+                                     float bound) -> float {
+  float sum = 0.0F;
+  size_t i = 0;
+  for (; i < NUM_DISTANCE_BLOCKS && sum < bound; ++i) {
+    sum += block_squared_distance(lhs, rhs, i);
+  }
+  ++distance_work_counter.calls;
+  distance_work_counter.blocks += i;
+  return sum;
+}
+
+auto Point::distance_work() -> DistanceWork { return distance_work_counter; }
+
+auto Point::distance(const Point &point1, const Point &point2) -> float {
+  return std::sqrt(squared_distance(point1.m_coordinates.data(),
+                                    point2.m_coordinates.data()));
 }
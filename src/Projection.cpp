@@ -0,0 +1,138 @@
+#include "Projection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+// Relative margin that absorbs the float error of the (almost) orthonormal rows
+constexpr float LOWER_BOUND_SLACK = 1e-4F;
+constexpr double DEGENERATE_NORM = 1e-9;
+
+/**
+ * orthonormalize
+ * Gram-Schmidt modificado (en doble precisión) sobre las filas. Una fila que
+ * queda degenerada se reemplaza por un vector canónico.
+ */
+void Projection::orthonormalize() {
+  std::vector<double> rows(m_rows.begin(), m_rows.end());
+  size_t next_canonical = 0;
+
+  for (size_t row = 0; row < PROJECTED_DIM; ++row) {
+    auto *current = rows.data() + row * DIM;
+
+    while (true) {
+      for (size_t prev = 0; prev < row; ++prev) {
+        const auto *previous = rows.data() + prev * DIM;
+        double dot = std::inner_product(current, current + DIM, previous, 0.0);
+        for (size_t i = 0; i < DIM; ++i) {
+          current[i] -= dot * previous[i];
+        }
+      }
+
+      double norm =
+          std::sqrt(std::inner_product(current, current + DIM, current, 0.0));
+      if (norm > DEGENERATE_NORM) {
+        for (size_t i = 0; i < DIM; ++i) {
+          current[i] /= norm;
+        }
+        break;
+      }
+      std::fill(current, current + DIM, 0.0);
+      current[next_canonical++ % DIM] = 1.0;
+    }
+  }
+
+  std::ranges::transform(rows, m_rows.begin(), [](double value) {
+    return static_cast<float>(value);
+  });
+}
+
+/**
+ * random
+ * Genera una proyección ortonormal aleatoria (filas gaussianas
+ * ortonormalizadas).
+ * @param seed Semilla del generador.
+ * @return Projection: Proyección generada.
+ */
+auto Projection::random(uint64_t seed) -> Projection {
+  std::mt19937_64 gen(seed);
+  std::normal_distribution<float> dis(0.0F, 1.0F);
+
+  Projection projection;
+  std::ranges::generate(projection.m_rows, [&]() { return dis(gen); });
+  projection.orthonormalize();
+  return projection;
+}
+
+/**
+ * pca
+ * Aproxima las PROJECTED_DIM componentes principales de la muestra mediante
+ * iteración de subespacios: las filas se multiplican por la covarianza de la
+ * muestra y se reortonormalizan en cada iteración.
+ * @param sample Puntos de entrenamiento.
+ * @param iterations Número de iteraciones.
+ * @return Projection: Proyección sobre las componentes principales.
+ */
+auto Projection::pca(const std::vector<Point> &sample, size_t iterations)
+    -> Projection {
+  auto projection = random(0);
+  if (sample.size() < 2) {
+    return projection;
+  }
+
+  Point mean = std::accumulate(sample.begin(), sample.end(), Point()) /
+               static_cast<float>(sample.size());
+
+  std::vector<float> next(PROJECTED_DIM * DIM);
+  std::array<float, DIM> centered{};
+  for (size_t iteration = 0; iteration < iterations; ++iteration) {
+    std::ranges::fill(next, 0.0F);
+
+    for (const auto &point : sample) {
+      for (size_t i = 0; i < DIM; ++i) {
+        centered.at(i) = point[i] - mean[i];
+      }
+      for (size_t row = 0; row < PROJECTED_DIM; ++row) {
+        const auto *current = projection.m_rows.data() + row * DIM;
+        float dot = std::inner_product(centered.begin(), centered.end(),
+                                       current, 0.0F);
+        auto *accumulated = next.data() + row * DIM;
+        for (size_t i = 0; i < DIM; ++i) {
+          accumulated[i] += dot * centered.at(i);
+        }
+      }
+    }
+
+    projection.m_rows.swap(next);
+    projection.orthonormalize();
+  }
+  return projection;
+}
+
+/**
+ * project
+ * Proyecta un punto al espacio reducido.
+ * @param point Punto a proyectar.
+ * @return ProjectedPoint: Coordenadas proyectadas.
+ */
+auto Projection::project(const Point &point) const -> ProjectedPoint {
+  ProjectedPoint projected{};
+  const float *coordinates = point.data();
+  for (size_t row = 0; row < PROJECTED_DIM; ++row) {
+    const auto *current = m_rows.data() + row * DIM;
+    projected.at(row) =
+        std::inner_product(coordinates, coordinates + DIM, current, 0.0F);
+  }
+  return projected;
+}
+
+auto Projection::lower_bound(const ProjectedPoint &point1,
+                             const ProjectedPoint &point2) -> float {
+  float sum = 0.0F;
+  for (size_t i = 0; i < PROJECTED_DIM; ++i) {
+    float diff = point1.at(i) - point2.at(i);
+    sum += diff * diff;
+  }
+  return std::sqrt(sum) * (1.0F - LOWER_BOUND_SLACK);
+}
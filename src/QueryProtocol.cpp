@@ -0,0 +1,151 @@
+#include "QueryProtocol.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+template <typename T> void append(std::vector<char> &out, const T &value) {
+  const auto *bytes = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+auto read(std::span<const char> payload, size_t offset) -> T {
+  T value;
+  std::memcpy(&value, payload.data() + offset, sizeof(T));
+  return value;
+}
+
+constexpr size_t EMBEDDING_SIZE = DIM * sizeof(float);
+
+// Tests the IEEE 754 bits rather than comparing: release builds use
+// -ffinite-math-only, under which the compiler may fold `radius >= 0` for
+// a NaN to true. Rejects NaN, infinities and negative radii.
+auto is_valid_radius(float radius) -> bool {
+  constexpr uint32_t SIGN_BIT = 0x80000000U;
+  constexpr uint32_t EXPONENT_BITS = 0x7F800000U;
+  auto bits = std::bit_cast<uint32_t>(radius);
+  bool finite = (bits & EXPONENT_BITS) != EXPONENT_BITS;
+  // -0 compares equal to 0, so it is accepted like 0
+  bool negative = (bits & SIGN_BIT) != 0 && (bits & ~SIGN_BIT) != 0;
+  return finite && !negative;
+}
+
+// Writes a header whose payload_size is fixed up once the payload is known
+template <typename Header>
+auto begin_message(Header header, std::vector<char> &out) -> size_t {
+  auto start = out.size();
+  append(out, header);
+  return start;
+}
+
+template <typename Header>
+void end_message(size_t start, std::vector<char> &out) {
+  auto payload_size = static_cast<uint32_t>(out.size() - start - sizeof(Header));
+  std::memcpy(out.data() + start + offsetof(Header, payload_size),
+              &payload_size, sizeof(payload_size));
+}
+
+} // namespace
+
+void encode_request(const Request &request, std::vector<char> &out) {
+  auto start = begin_message(RequestHeader{.payload_size = 0,
+                                           .type = request.type,
+                                           .request_id = request.request_id},
+                             out);
+  switch (request.type) {
+  case RequestType::KNN:
+    append(out, request.k);
+    break;
+  case RequestType::RANGE:
+    append(out, request.radius);
+    break;
+  case RequestType::INSERT:
+    append(out, request.id);
+    break;
+  }
+  const auto *embedding = reinterpret_cast<const char *>(request.query.data());
+  out.insert(out.end(), embedding, embedding + EMBEDDING_SIZE);
+  if (request.type == RequestType::INSERT) {
+    out.insert(out.end(), request.path.begin(), request.path.end());
+  }
+  end_message<RequestHeader>(start, out);
+}
+
+/**
+ * decodeRequest
+ * Interpreta el payload de un pedido según el tipo de su cabecera.
+ * @param header Cabecera del pedido.
+ * @param payload Bytes que siguen a la cabecera.
+ * @return std::optional<Request>: Pedido, o nullopt si está mal formado.
+ */
+auto decode_request(const RequestHeader &header, std::span<const char> payload)
+    -> std::optional<Request> {
+  size_t prefix_size = 0;
+  switch (header.type) {
+  case RequestType::KNN:
+  case RequestType::RANGE:
+    prefix_size = sizeof(uint32_t);
+    if (payload.size() != prefix_size + EMBEDDING_SIZE) {
+      return std::nullopt;
+    }
+    break;
+  case RequestType::INSERT:
+    prefix_size = sizeof(uint64_t);
+    if (payload.size() < prefix_size + EMBEDDING_SIZE) {
+      return std::nullopt;
+    }
+    break;
+  default:
+    return std::nullopt;
+  }
+
+  std::array<float, DIM> coordinates{};
+  std::memcpy(coordinates.data(), payload.data() + prefix_size, EMBEDDING_SIZE);
+  Request request{.type = header.type,
+                  .request_id = header.request_id,
+                  .query = Point(coordinates)};
+
+  switch (header.type) {
+  case RequestType::KNN:
+    request.k = read<uint32_t>(payload, 0);
+    if (request.k == 0) {
+      return std::nullopt;
+    }
+    break;
+  case RequestType::RANGE:
+    request.radius = read<float>(payload, 0);
+    if (!is_valid_radius(request.radius)) {
+      return std::nullopt;
+    }
+    break;
+  case RequestType::INSERT:
+    request.id = read<uint64_t>(payload, 0);
+    request.path.assign(payload.begin() + static_cast<int64_t>(prefix_size +
+                                                               EMBEDDING_SIZE),
+                        payload.end());
+    break;
+  }
+  return request;
+}
+
+void encode_response(uint64_t request_id, ResponseStatus status,
+                     const std::vector<Neighbor> &neighbors,
+                     std::vector<char> &out) {
+  auto start = begin_message(ResponseHeader{.payload_size = 0,
+                                            .status = status,
+                                            .request_id = request_id},
+                             out);
+  append(out, static_cast<uint32_t>(neighbors.size()));
+  for (const auto &neighbor : neighbors) {
+    const auto &path = neighbor.data->get_path();
+    append(out, neighbor.data->get_id());
+    append(out, neighbor.distance);
+    append(out, static_cast<uint32_t>(path.size()));
+    out.insert(out.end(), path.begin(), path.end());
+  }
+  end_message<ResponseHeader>(start, out);
+}
@@ -0,0 +1,516 @@
+#include "QueryServer.hpp"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+// epoll ids of the server's own descriptors; connections come after them
+constexpr uint64_t LISTEN_ID = 0;
+constexpr uint64_t STOP_ID = 1;
+constexpr uint64_t TIMER_ID = 2;
+constexpr uint64_t DONE_ID = 3;
+constexpr uint64_t FIRST_CONNECTION_ID = 4;
+
+constexpr size_t READ_CHUNK = 64UL * 1024;
+// A batch worth of these is all a connection buffers before it is parsed
+constexpr size_t KNN_MESSAGE_SIZE =
+    sizeof(RequestHeader) + sizeof(uint32_t) + (DIM * sizeof(float));
+constexpr size_t MAX_EVENTS = 64;
+
+[[noreturn]] void throw_errno(const char *what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+void watch(int epoll_fd, int fd, uint64_t id, uint32_t events, int operation) {
+  epoll_event event{};
+  event.events = events;
+  event.data.u64 = id;
+  if (epoll_ctl(epoll_fd, operation, fd, &event) == -1) {
+    throw_errno("epoll_ctl");
+  }
+}
+
+} // namespace
+
+QueryServer::QueryServer(AnySSTree &tree, const ServerOptions &options)
+    : m_tree(tree), m_options(options),
+      m_next_connection(FIRST_CONNECTION_ID) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (m_options.socket_path.empty() ||
+      m_options.socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("Invalid socket path: " +
+                                m_options.socket_path);
+  }
+  std::memcpy(address.sun_path, m_options.socket_path.c_str(),
+              m_options.socket_path.size());
+
+  auto close_all = [this] {
+    for (int fd : {m_listen_fd, m_epoll_fd, m_stop_fd, m_timer_fd, m_done_fd}) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  };
+
+  try {
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen_fd == -1) {
+      throw_errno("socket");
+    }
+    // A socket file left by a previous run would make bind fail
+    unlink(m_options.socket_path.c_str());
+    if (bind(m_listen_fd, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) == -1) {
+      throw_errno("bind");
+    }
+    if (listen(m_listen_fd, SOMAXCONN) == -1) {
+      throw_errno("listen");
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    m_done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd == -1 || m_stop_fd == -1 || m_timer_fd == -1 ||
+        m_done_fd == -1) {
+      throw_errno("epoll_create1/eventfd/timerfd_create");
+    }
+    watch(m_epoll_fd, m_listen_fd, LISTEN_ID, EPOLLIN, EPOLL_CTL_ADD);
+    watch(m_epoll_fd, m_stop_fd, STOP_ID, EPOLLIN, EPOLL_CTL_ADD);
+    watch(m_epoll_fd, m_timer_fd, TIMER_ID, EPOLLIN, EPOLL_CTL_ADD);
+    watch(m_epoll_fd, m_done_fd, DONE_ID, EPOLLIN, EPOLL_CTL_ADD);
+  } catch (...) {
+    close_all();
+    throw;
+  }
+
+  for (size_t worker = 0; worker < std::max<size_t>(m_options.num_workers, 1);
+       ++worker) {
+    m_workers.push_back(std::make_unique<WorkerThread>());
+  }
+}
+
+QueryServer::~QueryServer() {
+  // Joins the workers before the descriptors they signal are closed
+  m_workers.clear();
+  for (const auto &[id, connection] : m_connections) {
+    close(connection.fd);
+  }
+  close(m_done_fd);
+  close(m_timer_fd);
+  close(m_stop_fd);
+  close(m_epoll_fd);
+  close(m_listen_fd);
+  unlink(m_options.socket_path.c_str());
+}
+
+void QueryServer::stop() const {
+  uint64_t one = 1;
+  auto written = write(m_stop_fd, &one, sizeof(one));
+  static_cast<void>(written);
+}
+
+/**
+ * run
+ * Bucle de eventos: acepta conexiones, lee pedidos, lanza el lote pendiente
+ * cuando se llena o vence su plazo y envía las respuestas del lote en curso
+ * cuando termina. Al detenerse espera a que terminen los lotes pendientes
+ * antes de volver.
+ */
+void QueryServer::run() {
+  std::array<epoll_event, MAX_EVENTS> events{};
+  bool stopping = false;
+
+  while (!stopping) {
+    int num_events = epoll_wait(m_epoll_fd, events.data(),
+                                static_cast<int>(events.size()), -1);
+    if (num_events == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("epoll_wait");
+    }
+
+    for (const auto &event :
+         std::span(events).first(static_cast<size_t>(num_events))) {
+      switch (event.data.u64) {
+      case LISTEN_ID:
+        accept_connections();
+        break;
+      case STOP_ID:
+        stopping = true;
+        break;
+      case TIMER_ID: {
+        uint64_t expirations = 0;
+        auto bytes = read(m_timer_fd, &expirations, sizeof(expirations));
+        static_cast<void>(bytes);
+        m_batch_due = true;
+        start_batch();
+        break;
+      }
+      case DONE_ID:
+        finish_batch();
+        break;
+      default:
+        // A connection closed earlier in this round is no longer in the map
+        if ((event.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+          read_requests(event.data.u64);
+        }
+        if ((event.events & EPOLLOUT) != 0) {
+          flush_output(event.data.u64);
+        }
+        break;
+      }
+    }
+  }
+
+  start_batch();
+  while (!m_running.empty()) {
+    pollfd done{.fd = m_done_fd, .events = POLLIN, .revents = 0};
+    if (poll(&done, 1, -1) == -1 && errno != EINTR) {
+      throw_errno("poll");
+    }
+    finish_batch();
+    start_batch();
+  }
+}
+
+void QueryServer::accept_connections() {
+  while (true) {
+    int fd = accept4(m_listen_fd, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // EAGAIN: no more pending connections. Anything else (e.g. EMFILE)
+      // leaves them queued until a descriptor is free.
+      return;
+    }
+    auto id = m_next_connection++;
+    m_connections.emplace(id, Connection{.fd = fd, .events = EPOLLIN});
+    watch(m_epoll_fd, fd, id, EPOLLIN, EPOLL_CTL_ADD);
+    ++m_stats.connections;
+  }
+}
+
+/**
+ * readRequests
+ * Lee de una conexión hasta tener un lote de bytes y encola cada pedido
+ * completo. Un pedido mal formado entra al lote ya fallido, para responderle
+ * en orden; una cabecera imposible cierra la conexión porque ya no se puede
+ * saber dónde empieza el siguiente mensaje. Si el cliente cerró su lado de
+ * escritura, se responde lo recibido antes de cerrar. Si el próximo lote ya
+ * está lleno, la conexión deja de leerse hasta que ese lote empiece.
+ * @param connection_id Conexión con datos pendientes.
+ */
+void QueryServer::read_requests(uint64_t connection_id) {
+  auto it = m_connections.find(connection_id);
+  if (it == m_connections.end()) {
+    return;
+  }
+  Connection &connection = it->second;
+
+  if (m_batch.size() >= m_options.max_batch_size) {
+    connection.paused = true;
+    m_paused.push_back(connection_id);
+    update_events(connection_id, connection);
+    return;
+  }
+
+  // The rest stays in the socket until the next round. A message larger
+  // than a batch is still read whole once it is at the front.
+  auto read_limit = std::max<size_t>(m_options.max_batch_size, 1) *
+                    KNN_MESSAGE_SIZE;
+  if (connection.input.size() >= sizeof(RequestHeader)) {
+    RequestHeader header{};
+    std::memcpy(&header, connection.input.data(), sizeof(header));
+    read_limit = std::max<size_t>(read_limit, sizeof(header) +
+                                                  header.payload_size);
+  }
+
+  while (!connection.eof && connection.input.size() < read_limit) {
+    auto old_size = connection.input.size();
+    auto chunk = std::min(READ_CHUNK, read_limit - old_size);
+    connection.input.resize(old_size + chunk);
+    auto bytes =
+        recv(connection.fd, connection.input.data() + old_size, chunk, 0);
+    connection.input.resize(old_size + (bytes > 0 ? static_cast<size_t>(bytes)
+                                                  : 0));
+    if (bytes > 0) {
+      continue;
+    }
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    }
+    if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (bytes == -1) {
+      close_connection(connection_id);
+      return;
+    }
+    // Orderly shutdown: answer what already arrived, then close
+    connection.eof = true;
+  }
+
+  size_t offset = 0;
+  while (connection.input.size() - offset >= sizeof(RequestHeader)) {
+    RequestHeader header{};
+    std::memcpy(&header, connection.input.data() + offset, sizeof(header));
+    if (header.payload_size > MAX_PAYLOAD_SIZE) {
+      close_connection(connection_id);
+      return;
+    }
+    auto message_size = sizeof(header) + header.payload_size;
+    if (connection.input.size() - offset < message_size) {
+      break;
+    }
+    auto request = decode_request(
+        header, std::span(connection.input)
+                    .subspan(offset + sizeof(header), header.payload_size));
+    if (request) {
+      enqueue(connection_id, *request, ResponseStatus::OK);
+    } else {
+      Request rejected{};
+      rejected.type = header.type;
+      rejected.request_id = header.request_id;
+      enqueue(connection_id, rejected, ResponseStatus::BAD_REQUEST);
+    }
+    offset += message_size;
+  }
+  connection.input.erase(connection.input.begin(),
+                         connection.input.begin() +
+                             static_cast<int64_t>(offset));
+
+  // Drops EPOLLIN after EOF, or closes the connection if nothing is left to
+  // answer, so nothing touches it afterwards
+  flush_output(connection_id);
+  if (m_batch.size() >= m_options.max_batch_size ||
+      m_options.max_wait.count() == 0) {
+    start_batch();
+  }
+}
+
+void QueryServer::enqueue(uint64_t connection_id, const Request &request,
+                          ResponseStatus status) {
+  if (m_batch.empty()) {
+    arm_timer(m_options.max_wait);
+  }
+  m_batch.push_back(
+      {.connection = connection_id, .request = request, .status = status});
+  ++m_connections.at(connection_id).in_batch;
+}
+
+/**
+ * startBatch
+ * Lanza el lote pendiente si no hay otro en curso. Un hilo de trabajo ejecuta
+ * primero las inserciones en orden de llegada y luego reparte las consultas
+ * entre todos; el último en terminar avisa por m_done_fd.
+ */
+void QueryServer::start_batch() {
+  if (!m_running.empty() || m_batch.empty()) {
+    return;
+  }
+  arm_timer(std::chrono::microseconds(0));
+  m_batch_due = false;
+  std::swap(m_running, m_batch);
+  ++m_stats.batches;
+  m_stats.requests += m_running.size();
+
+  m_results.resize(m_running.size());
+  m_statuses.resize(m_running.size());
+  for (size_t i = 0; i < m_running.size(); ++i) {
+    m_statuses[i] = m_running[i].status;
+  }
+
+  // The next batch has room again
+  for (auto connection_id : m_paused) {
+    auto it = m_connections.find(connection_id);
+    if (it != m_connections.end()) {
+      it->second.paused = false;
+      update_events(connection_id, it->second);
+    }
+  }
+  m_paused.clear();
+
+  auto num_workers = m_workers.size();
+  m_running_workers.store(num_workers);
+  m_workers.front()->post([this, num_workers] {
+    for (size_t i = 0; i < m_running.size(); ++i) {
+      const auto &request = m_running[i].request;
+      if (m_statuses[i] != ResponseStatus::OK ||
+          request.type != RequestType::INSERT) {
+        continue;
+      }
+      try {
+        m_tree.insert(
+            std::make_shared<Data>(request.query, request.path, request.id));
+      } catch (const std::exception &) {
+        m_statuses[i] = ResponseStatus::ERROR;
+      }
+    }
+
+    for (size_t worker = 0; worker < num_workers; ++worker) {
+      m_workers[worker]->post([this, worker, num_workers] {
+        for (size_t i = worker; i < m_running.size(); i += num_workers) {
+          const auto &request = m_running[i].request;
+          if (m_statuses[i] != ResponseStatus::OK) {
+            continue;
+          }
+          try {
+            if (request.type == RequestType::KNN) {
+              m_results[i] = m_tree.knn(request.query, request.k, {});
+            } else if (request.type == RequestType::RANGE) {
+              m_results[i] = m_tree.range(request.query, request.radius, {});
+            }
+          } catch (const std::exception &) {
+            m_statuses[i] = ResponseStatus::ERROR;
+          }
+        }
+        if (m_running_workers.fetch_sub(1) == 1) {
+          uint64_t one = 1;
+          auto written = write(m_done_fd, &one, sizeof(one));
+          static_cast<void>(written);
+        }
+      });
+    }
+  });
+}
+
+/**
+ * finishBatch
+ * Encola las respuestas del lote terminado en orden de llegada, así que cada
+ * conexión las recibe en el orden en que envió los pedidos, y lanza el
+ * siguiente lote si ya está listo.
+ */
+void QueryServer::finish_batch() {
+  uint64_t count = 0;
+  auto bytes = read(m_done_fd, &count, sizeof(count));
+  static_cast<void>(bytes);
+  // Also orders the workers' writes before the reads below
+  if (m_running.empty() || m_running_workers.load() != 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < m_running.size(); ++i) {
+    auto it = m_connections.find(m_running[i].connection);
+    if (it != m_connections.end()) {
+      encode_response(m_running[i].request.request_id, m_statuses[i],
+                      m_results[i], it->second.output);
+      --it->second.in_batch;
+    }
+    m_results[i].clear();
+  }
+  for (const auto &pending : m_running) {
+    flush_output(pending.connection);
+  }
+  m_running.clear();
+
+  if (m_batch_due || m_batch.size() >= m_options.max_batch_size ||
+      m_options.max_wait.count() == 0) {
+    start_batch();
+  }
+}
+
+/**
+ * flushOutput
+ * Envía lo posible de las respuestas encoladas. Si el socket se llena, la
+ * conexión se registra para EPOLLOUT hasta vaciarlas. Una conexión cuyo
+ * cliente cerró su lado de escritura se cierra cuando ya no le queda nada
+ * por responder.
+ * @param connection_id Conexión con respuestas pendientes.
+ */
+void QueryServer::flush_output(uint64_t connection_id) {
+  auto it = m_connections.find(connection_id);
+  if (it == m_connections.end()) {
+    return;
+  }
+  Connection &connection = it->second;
+
+  while (connection.output_offset < connection.output.size()) {
+    auto bytes = send(connection.fd,
+                      connection.output.data() + connection.output_offset,
+                      connection.output.size() - connection.output_offset,
+                      MSG_NOSIGNAL);
+    if (bytes >= 0) {
+      connection.output_offset += static_cast<size_t>(bytes);
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else if (errno != EINTR) {
+      close_connection(connection_id);
+      return;
+    }
+  }
+
+  bool pending = connection.output_offset < connection.output.size();
+  if (!pending) {
+    connection.output.clear();
+    connection.output_offset = 0;
+    if (connection.eof && connection.in_batch == 0) {
+      close_connection(connection_id);
+      return;
+    }
+  }
+  update_events(connection_id, connection);
+}
+
+// Registers the connection for what it waits on. A level-triggered EPOLLIN
+// would fire on every round after EOF or while paused, and EPOLLHUP is
+// reported even with no events, so a connection waiting on nothing leaves
+// the epoll set.
+void QueryServer::update_events(uint64_t connection_id,
+                                Connection &connection) {
+  bool reading = !connection.eof && !connection.paused;
+  bool writing = connection.output_offset < connection.output.size();
+  uint32_t events = (reading ? static_cast<uint32_t>(EPOLLIN) : 0U) |
+                    (writing ? static_cast<uint32_t>(EPOLLOUT) : 0U);
+  if (events == connection.events) {
+    return;
+  }
+  if (events == 0) {
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+  } else {
+    watch(m_epoll_fd, connection.fd, connection_id, events,
+          connection.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+  }
+  connection.events = events;
+}
+
+void QueryServer::close_connection(uint64_t connection_id) {
+  auto it = m_connections.find(connection_id);
+  if (it == m_connections.end()) {
+    return;
+  }
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+  close(it->second.fd);
+  m_connections.erase(it);
+}
+
+// A zero delay disarms the timer
+void QueryServer::arm_timer(std::chrono::microseconds delay) const {
+  itimerspec spec{};
+  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(delay);
+  spec.it_value.tv_sec = static_cast<time_t>(seconds.count());
+  spec.it_value.tv_nsec = static_cast<long>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(delay - seconds)
+          .count());
+  if (timerfd_settime(m_timer_fd, 0, &spec, nullptr) == -1) {
+    throw_errno("timerfd_settime");
+  }
+}
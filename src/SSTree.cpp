@@ -1,9 +1,12 @@
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <numeric>
+#include <queue>
 #include <ranges>
+#include <tuple>
 
 #include "SSTree.hpp"
 
@@ -43,101 +46,217 @@ auto SSNode<MAX_POINTS_PER_NODE>::intersects_point(const Point &point) const
 /**
  * findClosestChild
  * Encuentra el hijo más cercano a un punto dado.
+ * Con proyección, los hijos se recorren en orden de su cota inferior
+ * proyectada y la distancia completa solo se calcula mientras esa cota no
+ * supere la mejor distancia encontrada. Cada distancia se abandona en cuanto
+ * supera la del mejor hijo hasta el momento.
  * @param target El punto objetivo para encontrar el hijo más cercano.
+ * @param projected_target Proyección del objetivo (o nullptr).
  * @return SSNode*: Retorna un puntero al hijo más cercano.
  */
 template <size_t MAX_POINTS_PER_NODE>
-auto SSNode<MAX_POINTS_PER_NODE>::find_closest_child(const Point &target)
+auto SSNode<MAX_POINTS_PER_NODE>::find_closest_child(
+    const Point &target, const ProjectedPoint *projected_target)
     -> std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> {
-  return *std::ranges::min_element(
-      m_children, [&target](const auto &child1, const auto &child2) {
-        return Point::distance(child1->get_centroid(), target) <
-               Point::distance(child2->get_centroid(), target);
-      });
+  if (projected_target == nullptr) {
+    size_t closest = 0;
+    float closest_squared = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < m_children.size(); ++i) {
+      auto squared = Point::bounded_squared_distance(
+          m_children[i]->m_centroid.data(), target.data(), closest_squared);
+      if (squared < closest_squared) {
+        closest_squared = squared;
+        closest = i;
+      }
+    }
+    return m_children[closest];
+  }
+
+  // A node holds at most MAX_POINTS_PER_NODE + 1 entries (before splitting)
+  std::array<std::pair<float, size_t>, MAX_POINTS_PER_NODE + 1> bounds{};
+  auto num_children = std::min(m_children.size(), bounds.size());
+  for (size_t i = 0; i < num_children; ++i) {
+    bounds.at(i) = {Projection::lower_bound(*projected_target,
+                                            m_children[i]->m_projected_centroid),
+                    i};
+  }
+  std::sort(bounds.begin(),
+            bounds.begin() + static_cast<int64_t>(num_children));
+
+  size_t closest = bounds.front().second;
+  float closest_squared = std::numeric_limits<float>::max();
+  for (size_t i = 0; i < num_children; ++i) {
+    auto [bound, index] = bounds.at(i);
+    if (bound * bound >= closest_squared) {
+      break;
+    }
+    auto squared = Point::bounded_squared_distance(
+        m_children[index]->m_centroid.data(), target.data(), closest_squared);
+    if (squared < closest_squared) {
+      closest_squared = squared;
+      closest = index;
+    }
+  }
+  return m_children[closest];
+}
+
+/**
+ * project
+ * Proyecta un punto con la proyección del nodo, si la tiene.
+ * @param target Punto a proyectar.
+ * @return std::optional<ProjectedPoint>: Proyección o nullopt.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto SSNode<MAX_POINTS_PER_NODE>::project(const Point &target) const
+    -> std::optional<ProjectedPoint> {
+  if (m_projection == nullptr || m_isLeaf) {
+    return std::nullopt;
+  }
+  return m_projection->project(target);
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+void SSNode<MAX_POINTS_PER_NODE>::set_projection(
+    const std::shared_ptr<const Projection> &projection) {
+  m_projection = projection;
+  if (m_projection != nullptr) {
+    m_projected_centroid = m_projection->project(m_centroid);
+  }
 }
 
 /**
  * updateBoundingEnvelope
  * Actualiza el centroide y el radio del nodo basándose en los nodos internos o
- * datos.
+ * datos, y guarda la distancia de cada entrada al nuevo centroide.
  *
  */
 template <size_t MAX_POINTS_PER_NODE>
 void SSNode<MAX_POINTS_PER_NODE>::update_bounding_envelope() {
-  auto points = get_entries_centroids();
-  m_centroid = std::accumulate(points.begin(), points.end(), Point(),
-                               [](const auto &point1, const auto &point2) {
-                                 return point1 + point2;
-                               }) /
-               static_cast<float>(points.size());
-
-  m_radius = std::ranges::max(
-      points | std::ranges::views::transform([&](const Point &point) {
-        return Point::distance(point, m_centroid);
-      }));
+  auto num_entries = get_num_entries();
+
+  // Accumulated in place, no temporaries
+  m_centroid = Point();
+  for (size_t i = 0; i < num_entries; ++i) {
+    m_centroid += get_entry_centroid(i);
+  }
+  m_centroid /= static_cast<float>(num_entries);
+
+  if (m_projection != nullptr) {
+    m_projected_centroid = m_projection->project(m_centroid);
+  }
+
+  m_entry_distances.clear();
+  for (size_t i = 0; i < num_entries; ++i) {
+    m_entry_distances.push_back(
+        Point::distance(get_entry_centroid(i), m_centroid));
+  }
+
+  m_id_range = {};
+  if (m_isLeaf) {
+    for (const auto &data : m_data) {
+      m_id_range.include(data->get_id());
+    }
+    m_radius = std::ranges::max(m_entry_distances);
+    return;
+  }
+
+  for (const auto &child : m_children) {
+    m_id_range.include(child->get_id_range());
+  }
+
+  // The sphere of an internal node must enclose its children's spheres
+  m_radius = 0.0F;
+  for (size_t i = 0; i < m_children.size(); ++i) {
+    m_radius =
+        std::max(m_radius, m_entry_distances[i] + m_children[i]->get_radius());
+  }
 }
 
 /**
  * directionOfMaxVariance
  * Calcula y retorna el índice de la dirección de máxima varianza.
+ * Las sumas y sumas de cuadrados de todas las dimensiones se acumulan en una
+ * sola pasada sobre las entradas.
  * @return size_t: Índice de la dirección de máxima varianza.
  */
 template <size_t MAX_POINTS_PER_NODE>
 auto SSNode<MAX_POINTS_PER_NODE>::direction_of_max_variance() -> size_t {
 
-  auto centroids = get_entries_centroids();
+  auto num_entries = get_num_entries();
+  std::array<double, DIM> sums{};
+  std::array<double, DIM> sums_of_squares{};
 
-  auto kth_elements_view = [&centroids](size_t dim) {
-    return centroids |
-           std::views::transform([dim](const auto &vec) { return vec[dim]; });
-  };
+  for (size_t i = 0; i < num_entries; ++i) {
+    const float *coordinates = get_entry_centroid(i).data();
+    for (size_t dim = 0; dim < DIM; ++dim) {
+      auto coordinate = static_cast<double>(coordinates[dim]);
+      sums.at(dim) += coordinate;
+      sums_of_squares.at(dim) += coordinate * coordinate;
+    }
+  }
 
-  auto max_variance_dim = std::ranges::max_element(
-      std::views::iota(0UL, DIM),
-      [&kth_elements_view](const auto &dim1, const auto &dim2) {
-        auto variance1 = variance(kth_elements_view(dim1));
-        auto variance2 = variance(kth_elements_view(dim2));
+  // The n / (n - 1) correction is the same for every dimension
+  auto size = static_cast<double>(num_entries);
+  auto dim_variance = [&](size_t dim) {
+    auto mean = sums.at(dim) / size;
+    return sums_of_squares.at(dim) / size - mean * mean;
+  };
 
-        return variance1 < variance2;
-      });
-  return *max_variance_dim;
+  return *std::ranges::max_element(std::views::iota(0UL, DIM), {},
+                                   dim_variance);
 }
 
 /**
  * split
- * Divide el nodo y retorna el nuevo nodo creado.
+ * Divide el nodo: este nodo conserva la primera mitad de las entradas y se
+ * crea un nodo nuevo con la segunda mitad, moviendo (no copiando) las
+ * entradas.
  * Implementación similar a R-tree.
- * @return SSNode*: Puntero al nuevo nodo creado por la división.
+ * @return split_t: Este nodo y el nuevo nodo creado por la división.
  */
 template <size_t MAX_POINTS_PER_NODE>
 auto SSNode<MAX_POINTS_PER_NODE>::split() -> split_t {
 
   auto coordinate_index = direction_of_max_variance();
 
-  auto split_index = find_split_index(coordinate_index);
+  // Entries are ordered along the split coordinate so that the split index
+  // partitions them the same way it partitions the sorted values
+  if (m_isLeaf) {
+    std::ranges::sort(m_data, {}, [&coordinate_index](const auto &data) {
+      return data->get_embedding()[coordinate_index];
+    });
+  } else {
+    std::ranges::sort(m_children, {}, [&coordinate_index](const auto &child) {
+      return child->get_centroid()[coordinate_index];
+    });
+  }
 
+  auto split_index = static_cast<int64_t>(find_split_index(coordinate_index));
+  auto parent = m_parent.lock();
+
+  auto move_tail = [split_index](auto &entries) {
+    std::remove_reference_t<decltype(entries)> tail;
+    tail.reserve(MAX_POINTS_PER_NODE + 1);
+    tail.insert(tail.end(),
+                std::make_move_iterator(entries.begin() + split_index),
+                std::make_move_iterator(entries.end()));
+    entries.erase(entries.begin() + split_index, entries.end());
+    return tail;
+  };
+
+  std::shared_ptr<SSNode> new_node;
   if (m_isLeaf) {
-    auto new_node1 = std::make_shared<SSNode<MAX_POINTS_PER_NODE>>(
-        std::vector(m_data.begin(),
-                    m_data.begin() + static_cast<int64_t>(split_index)),
-        this->shared_from_this());
-    auto new_node2 = std::make_shared<SSNode<MAX_POINTS_PER_NODE>>(
-        std::vector(m_data.begin() + static_cast<int64_t>(split_index),
-                    m_data.end()),
-        this->shared_from_this());
-    return std::make_pair(new_node1, new_node2);
-  }
-
-  auto new_node1 = std::make_shared<SSNode<MAX_POINTS_PER_NODE>>(
-      std::vector(m_children.begin(),
-                  m_children.begin() + static_cast<int64_t>(split_index)),
-      this->shared_from_this());
-  auto new_node2 = std::make_shared<SSNode<MAX_POINTS_PER_NODE>>(
-      std::vector(m_children.begin() + static_cast<int64_t>(split_index),
-                  m_children.end()),
-      this->shared_from_this());
-
-  return std::make_pair(new_node1, new_node2);
+    new_node = std::make_shared<SSNode>(move_tail(m_data), parent);
+  } else {
+    new_node = std::make_shared<SSNode>(move_tail(m_children), parent);
+    for (const auto &child : new_node->get_children()) {
+      child->set_parent(new_node);
+    }
+  }
+  new_node->set_projection(m_projection);
+  update_bounding_envelope();
+
+  return std::make_pair(this->shared_from_this(), new_node);
 }
 
 template <size_t MAX_POINTS_PER_NODE>
@@ -156,6 +275,8 @@ void SSNode<MAX_POINTS_PER_NODE>::add_data(const std::shared_ptr<Data> &_data) {
 /**
  * findSplitIndex
  * Encuentra el índice de división en una coordenada específica.
+ * Las entradas ya están ordenadas por esa coordenada; los valores se copian a
+ * un buffer reutilizable por hilo.
  * @param coordinate_index Índice de la coordenada para encontrar el índice de
  * división.
  * @return size_t: Índice de la división.
@@ -164,60 +285,45 @@ template <size_t MAX_POINTS_PER_NODE>
 auto SSNode<MAX_POINTS_PER_NODE>::find_split_index(size_t coordinate_index)
     -> size_t {
 
-  std::vector<float> values;
-  std::ranges::transform(get_entries_centroids(), std::back_inserter(values),
-                         [&coordinate_index](const auto &point) {
-                           return point[coordinate_index];
-                         });
+  thread_local std::vector<float> values;
+  values.clear();
+  for (size_t i = 0; i < get_num_entries(); ++i) {
+    values.push_back(get_entry_centroid(i)[coordinate_index]);
+  }
   return min_variance_split(values);
 }
 
 /**
- * getEntriesCentroids
- * Devuelve los centroides de las entradas.
- * Estos centroides pueden ser puntos almacenados en las hojas o los centroides
- * de los nodos hijos en los nodos internos.
- * @return std::vector<Point>: Vector de centroides de las entradas.
+ * getEntryCentroid
+ * Devuelve el centroide de la i-ésima entrada: el punto almacenado en una hoja
+ * o el centroide del hijo en un nodo interno.
+ * @param index Índice de la entrada.
+ * @return const Point&: Centroide de la entrada.
  */
 template <size_t MAX_POINTS_PER_NODE>
-auto SSNode<MAX_POINTS_PER_NODE>::get_entries_centroids()
-    -> std::vector<Point> {
-
-  std::vector<Point> centroids;
-
-  if (m_isLeaf) {
-    std::ranges::transform(
-        m_data, std::back_inserter(centroids),
-        [](const auto &data) { return data->get_embedding(); });
-  } else {
-    std::ranges::transform(
-        m_children, std::back_inserter(centroids),
-        [](const auto &child) { return child->get_centroid(); });
-  }
-
-  return centroids;
+auto SSNode<MAX_POINTS_PER_NODE>::get_entry_centroid(size_t index) const
+    -> const Point & {
+  return m_isLeaf ? m_data[index]->get_embedding()
+                  : m_children[index]->get_centroid();
 }
 
 /**
  * minVarianceSplit
- * Encuentra el índice de división óptimo para una lista de valores, de tal
- * manera que la suma de las varianzas de las dos particiones resultantes sea
- * mínima.
- * @param values Vector de valores para encontrar el índice de mínima varianza.
+ * Encuentra el índice de división óptimo para una lista de valores ordenados,
+ * de tal manera que la suma de las varianzas de las dos particiones
+ * resultantes sea mínima.
+ * @param sorted_values Valores ordenados de menor a mayor.
  * @return size_t: Índice de mínima varianza.
  */
 template <size_t MAX_POINTS_PER_NODE>
 auto SSNode<MAX_POINTS_PER_NODE>::min_variance_split(
-    const std::vector<float> &values) const -> size_t {
-
-  auto sorted_values = values;
-  std::ranges::sort(sorted_values);
+    std::span<const float> sorted_values) const -> size_t {
 
   double min_variance = std::numeric_limits<double>::max();
 
   auto split_index = MIN_POINTS_PER_NODE::value;
 
-  for (auto i = split_index; i < values.size() - MIN_POINTS_PER_NODE::value;
+  for (auto i = split_index; i < sorted_values.size() - MIN_POINTS_PER_NODE::value;
        ++i) {
 
     auto variance1 = variance(
@@ -243,22 +349,40 @@ auto SSNode<MAX_POINTS_PER_NODE>::min_variance_split(
 template <size_t MAX_POINTS_PER_NODE>
 auto SSNode<MAX_POINTS_PER_NODE>::search_parent_leaf(const Point &target)
     -> std::shared_ptr<SSNode> {
+  auto projected_target = project(target);
+  return search_parent_leaf(target, projected_target ? &*projected_target
+                                                     : nullptr);
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+auto SSNode<MAX_POINTS_PER_NODE>::search_parent_leaf(
+    const Point &target, const ProjectedPoint *projected_target)
+    -> std::shared_ptr<SSNode> {
   if (m_isLeaf) {
     return this->shared_from_this();
   }
-  auto child = find_closest_child(target);
-  return child->search_parent_leaf(target);
+  auto child = find_closest_child(target, projected_target);
+  return child->search_parent_leaf(target, projected_target);
 }
 
 /**
  * insert
  * Inserta un dato en el nodo, dividiéndolo si es necesario.
+ * El embedding se proyecta una sola vez para todos los niveles.
  * @param data Dato a insertar.
  * @return SSNode*: Nuevo nodo raíz si se dividió, de lo contrario nullptr.
  */
 template <size_t MAX_POINTS_PER_NODE>
 auto SSNode<MAX_POINTS_PER_NODE>::insert(const std::shared_ptr<Data> &data)
     -> split_t {
+  auto projected_target = project(data->get_embedding());
+  return insert(data, projected_target ? &*projected_target : nullptr);
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+auto SSNode<MAX_POINTS_PER_NODE>::insert(const std::shared_ptr<Data> &data,
+                                         const ProjectedPoint *projected_target)
+    -> split_t {
 
   if (m_isLeaf) {
 
@@ -274,8 +398,9 @@ auto SSNode<MAX_POINTS_PER_NODE>::insert(const std::shared_ptr<Data> &data)
     return split();
   }
 
-  auto closest_child = find_closest_child(data->get_embedding());
-  auto new_nodes = closest_child->insert(data);
+  auto closest_child =
+      find_closest_child(data->get_embedding(), projected_target);
+  auto new_nodes = closest_child->insert(data, projected_target);
 
   if (new_nodes == std::nullopt) {
     update_bounding_envelope();
@@ -284,13 +409,16 @@ auto SSNode<MAX_POINTS_PER_NODE>::insert(const std::shared_ptr<Data> &data)
   // A split was made
 
   // remove closest_child from children
-  std::ranges::remove(m_children, closest_child);
+  std::erase(m_children, closest_child);
 
   // add the new nodes to the children
+  new_nodes->first->set_parent(this->shared_from_this());
+  new_nodes->second->set_parent(this->shared_from_this());
   m_children.push_back(new_nodes->first);
   m_children.push_back(new_nodes->second);
 
   if (m_children.size() <= MAX_POINTS_PER_NODE) {
+    update_bounding_envelope();
     return std::nullopt;
   }
   return split();
@@ -320,40 +448,407 @@ auto SSNode<MAX_POINTS_PER_NODE>::search(const Point &target)
   }
   return nullptr;
 }
+/**
+ * knn
+ * Busca los k vecinos más cercanos dentro del subárbol (best-first).
+ * Los nodos se expanden en orden de su distancia mínima posible al objetivo y
+ * la búsqueda termina cuando ningún nodo pendiente puede mejorar el heap.
+ * Solo los datos aceptados por el filtro llegan al heap, por lo que la
+ * frontera se sigue expandiendo hasta encontrar k datos elegibles. Los
+ * subárboles cuyo resumen de ids no contiene ningún id permitido se descartan.
+ * Antes de calcular la distancia completa a una entrada e de un nodo con
+ * centroide c se usa la cota |d(q,c) - d(e,c)| (desigualdad triangular) con
+ * las distancias guardadas en update_bounding_envelope y, si hay proyección,
+ * la distancia entre las proyecciones. Las distancias completas se abandonan
+ * en cuanto superan la k-ésima mejor distancia.
+ * @param target Punto de consulta.
+ * @param heap Heap acotado donde se acumulan los vecinos.
+ * @param filter Filtro evaluado antes de calcular cualquier distancia.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void SSNode<MAX_POINTS_PER_NODE>::knn(const Point &target, NeighborHeap &heap,
+                                      const SearchFilter &filter) const {
+  // (lower bound of the subtree, distance from target to centroid, node).
+  // Children enter with a cheap bound and a negative centroid distance; the
+  // full distance is only computed if they reach the top of the frontier.
+  using frontier_entry = std::tuple<float, float, const SSNode *>;
+  std::priority_queue<frontier_entry, std::vector<frontier_entry>,
+                      std::greater<>>
+      frontier;
+
+  if (!filter.may_contain(m_id_range)) {
+    return;
+  }
+  auto projected_target = project(target);
+  frontier.emplace(0.0F, -1.0F, this);
+
+  while (!frontier.empty()) {
+    auto [node_distance, centroid_distance, node] = frontier.top();
+    frontier.pop();
+
+    if (node_distance >= heap.worst_distance()) {
+      break;
+    }
+
+    if (centroid_distance < 0.0F) {
+      // Only useful while d(q,c) - radius stays below the k-th distance
+      auto reach = heap.worst_distance() + node->m_radius;
+      auto squared = Point::bounded_squared_distance(
+          node->m_centroid.data(), target.data(), reach * reach);
+      if (squared >= reach * reach) {
+        continue;
+      }
+      centroid_distance = std::sqrt(squared);
+      node_distance = std::max(0.0F, centroid_distance - node->m_radius);
+      frontier.emplace(node_distance, centroid_distance, node);
+      continue;
+    }
+
+    if (node->m_isLeaf) {
+      for (size_t i = 0; i < node->m_data.size(); ++i) {
+        const auto &data = node->m_data[i];
+        auto worst = heap.worst_distance();
+        if (std::abs(centroid_distance - node->m_entry_distances[i]) >= worst ||
+            !filter.accepts(*data)) {
+          continue;
+        }
+        auto squared = Point::bounded_squared_distance(
+            data->get_embedding().data(), target.data(), worst * worst);
+        if (squared < worst * worst) {
+          heap.push(std::sqrt(squared), data);
+        }
+      }
+      continue;
+    }
+
+    for (size_t i = 0; i < node->m_children.size(); ++i) {
+      const auto &child = node->m_children[i];
+      if (!filter.may_contain(child->m_id_range)) {
+        continue;
+      }
+      auto bound = std::abs(centroid_distance - node->m_entry_distances[i]);
+      if (projected_target) {
+        bound = std::max(bound, Projection::lower_bound(
+                                    *projected_target,
+                                    child->m_projected_centroid));
+      }
+      bound = std::max(0.0F, bound - child->m_radius);
+      if (bound < heap.worst_distance()) {
+        frontier.emplace(bound, -1.0F, child.get());
+      }
+    }
+  }
+}
+
+/**
+ * range
+ * Busca los datos elegibles a menos de `radius` del objetivo dentro del
+ * subárbol. Un nodo se descarta si su esfera no corta la de la consulta, y
+ * sus entradas con la cota |d(q,c) - d(e,c)| antes de calcular su distancia.
+ * @param target Punto de consulta.
+ * @param radius Radio de la consulta.
+ * @param result Vector donde se agregan los datos encontrados.
+ * @param filter Filtro evaluado antes de calcular cualquier distancia.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void SSNode<MAX_POINTS_PER_NODE>::range(const Point &target, float radius,
+                                        std::vector<Neighbor> &result,
+                                        const SearchFilter &filter) const {
+  if (!filter.may_contain(m_id_range)) {
+    return;
+  }
+  auto reach = radius + m_radius;
+  auto squared = Point::bounded_squared_distance(
+      m_centroid.data(), target.data(), reach * reach);
+  if (squared >= reach * reach) {
+    return;
+  }
+  auto centroid_distance = std::sqrt(squared);
+
+  if (m_isLeaf) {
+    for (size_t i = 0; i < m_data.size(); ++i) {
+      const auto &data = m_data[i];
+      if (std::abs(centroid_distance - m_entry_distances[i]) >= radius ||
+          !filter.accepts(*data)) {
+        continue;
+      }
+      auto entry_squared = Point::bounded_squared_distance(
+          data->get_embedding().data(), target.data(), radius * radius);
+      if (entry_squared < radius * radius) {
+        result.push_back({std::sqrt(entry_squared), data});
+      }
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < m_children.size(); ++i) {
+    if (std::abs(centroid_distance - m_entry_distances[i]) -
+            m_children[i]->m_radius <
+        radius) {
+      m_children[i]->range(target, radius, result, filter);
+    }
+  }
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+SSTree<MAX_POINTS_PER_NODE>::SSTree(const WriteBufferOptions &buffer_options)
+    : m_root(nullptr), m_buffer_options(buffer_options) {
+  m_buffer_options.batch_size = std::max<size_t>(m_buffer_options.batch_size, 1);
+  if (m_buffer_options.max_buffered == 0) {
+    m_buffer_options.max_buffered = 2 * m_buffer_options.flush_threshold;
+  }
+  m_buffer_options.max_buffered = std::max(m_buffer_options.max_buffered,
+                                           m_buffer_options.flush_threshold);
+  m_flush_batch.reserve(m_buffer_options.batch_size);
+
+  if (m_buffer_options.flush_threshold > 0 &&
+      m_buffer_options.background_flush) {
+    m_flush_thread = std::jthread(
+        [this](const std::stop_token &stop_token) { flush_worker(stop_token); });
+  }
+}
+
+/**
+ * insertIntoTree
+ * Inserta un dato directamente en los nodos, creando una nueva raíz si la
+ * raíz actual se divide. Requiere el lock exclusivo del árbol.
+ * @param data Dato a insertar.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void SSTree<MAX_POINTS_PER_NODE>::insert_into_tree(
+    const std::shared_ptr<Data> &data) {
+
+  if (m_root == nullptr) {
+    m_root = std::make_shared<SSNode>(data->get_embedding(), 0.0F);
+    m_root->set_projection(m_projection);
+  }
+
+  auto new_nodes = m_root->insert(data);
+  if (new_nodes == std::nullopt) {
+    return;
+  }
+
+  // The root was split, the tree grows one level
+  auto new_root = std::make_shared<SSNode>(
+      std::vector{new_nodes->first, new_nodes->second}, nullptr);
+  new_nodes->first->set_parent(new_root);
+  new_nodes->second->set_parent(new_root);
+  new_root->set_projection(m_projection);
+  m_root = new_root;
+}
+
+/**
+ * setProjection
+ * Asigna la proyección de enrutamiento a todos los nodos del árbol.
+ * @param projection Proyección entrenada.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void SSTree<MAX_POINTS_PER_NODE>::set_projection(const Projection &projection) {
+  std::unique_lock lock(m_tree_mutex);
+  m_projection = std::make_shared<const Projection>(projection);
+
+  if (m_root == nullptr) {
+    return;
+  }
+  std::vector<std::shared_ptr<SSNode>> pending{m_root};
+  while (!pending.empty()) {
+    auto node = pending.back();
+    pending.pop_back();
+    node->set_projection(m_projection);
+    std::ranges::copy(node->get_children(), std::back_inserter(pending));
+  }
+}
+
 /**
  * insert
  * Inserta un dato en el árbol.
+ * Con el buffer de escritura activo el dato se agrega al buffer y el árbol
+ * solo se modifica al alcanzar el umbral de vaciado.
  * @param data Dato a insertar.
  */
 template <size_t MAX_POINTS_PER_NODE>
 void SSTree<MAX_POINTS_PER_NODE>::insert(const std::shared_ptr<Data> &data) {
 
+#ifdef SSTREE_TRACE_INSERTS
   std::cout << "Inserting data: " << data->get_path() << '\n';
+#endif
 
-  if (m_root == nullptr) {
-    m_root = std::make_shared<SSNode>(data->get_embedding(), 0.0F);
+  if (m_buffer_options.flush_threshold == 0) {
+    std::unique_lock lock(m_tree_mutex);
+    insert_into_tree(data);
+    return;
+  }
+
+  size_t buffered = 0;
+  {
+    std::scoped_lock lock(m_buffer_mutex);
+    m_buffer.append(data);
+    buffered = m_buffer.size();
+  }
+
+  if (buffered < m_buffer_options.flush_threshold) {
+    return;
+  }
+  if (m_buffer_options.background_flush) {
+    m_flush_cv.notify_one();
+    if (buffered < m_buffer_options.max_buffered) {
+      return;
+    }
+  }
+  // At most one batch, so no insert pays for a whole flush
+  flush_batch();
+}
+
+/**
+ * flushBatch
+ * Mueve hasta batch_size entradas del buffer al árbol.
+ * @return bool - true si se movió alguna entrada.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto SSTree<MAX_POINTS_PER_NODE>::flush_batch() -> bool {
+  std::unique_lock tree_lock(m_tree_mutex);
+
+  {
+    std::scoped_lock lock(m_buffer_mutex);
+    m_buffer.copy_front(m_buffer_options.batch_size, m_flush_batch);
+  }
+
+  if (m_flush_batch.empty()) {
+    return false;
+  }
+
+  for (const auto &data : m_flush_batch) {
+    insert_into_tree(data);
+  }
+
+  {
+    std::scoped_lock lock(m_buffer_mutex);
+    m_buffer.erase_front(m_flush_batch.size());
   }
-  m_root->insert(data);
+  m_flush_batch.clear();
+  return true;
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+void SSTree<MAX_POINTS_PER_NODE>::flush() {
+  while (flush_batch()) {
+  }
+}
+
+/**
+ * flushWorker
+ * Hilo de fondo que vacía el buffer cada vez que alcanza el umbral.
+ * @param stop_token Señal de parada enviada al destruir el árbol.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void SSTree<MAX_POINTS_PER_NODE>::flush_worker(
+    const std::stop_token &stop_token) {
+  std::unique_lock lock(m_buffer_mutex);
+  while (m_flush_cv.wait(lock, stop_token, [this] {
+    return m_buffer.size() >= m_buffer_options.flush_threshold;
+  })) {
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+auto SSTree<MAX_POINTS_PER_NODE>::get_buffered_count() const -> size_t {
+  std::scoped_lock lock(m_buffer_mutex);
+  return m_buffer.size();
 }
 
 /**
  * search
  * Busca un dato específico en el árbol.
+ * Los datos pendientes en el buffer se vacían primero para que pertenezcan a
+ * algún nodo.
  * @param data Dato a buscar.
  * @return SSNode*: Nodo que contiene el dato (o nullptr si no se encuentra).
  */
 template <size_t MAX_POINTS_PER_NODE>
 auto SSTree<MAX_POINTS_PER_NODE>::search(const std::shared_ptr<Data> &data)
     -> std::shared_ptr<SSNode> {
+  flush();
+  std::shared_lock lock(m_tree_mutex);
+  if (m_root == nullptr) {
+    return nullptr;
+  }
   return m_root->search(data->get_embedding());
 }
 
-// Explicit instantiation
-template class SSTree<20>;
-template class SSNode<20>;
+/**
+ * knn
+ * Busca los k datos más cercanos a un punto, combinando la búsqueda en el
+ * árbol con un recorrido exhaustivo del buffer de escritura. El buffer se
+ * recorre sobre una instantánea, sin bloquear las inserciones.
+ * @param target Punto de consulta.
+ * @param k Número de vecinos.
+ * @param filter Restringe el resultado a los datos elegibles.
+ * @param shared_bound Cota compartida con búsquedas en otras particiones.
+ * @return std::vector<Neighbor>: Vecinos ordenados por distancia.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto SSTree<MAX_POINTS_PER_NODE>::knn(const Point &target, size_t k,
+                                      const SearchFilter &filter,
+                                      std::atomic<float> *shared_bound) const
+    -> std::vector<Neighbor> {
+  NeighborHeap heap(k, shared_bound);
+
+  WriteBuffer::Snapshot buffered;
+  {
+    std::shared_lock tree_lock(m_tree_mutex);
+    {
+      std::scoped_lock buffer_lock(m_buffer_mutex);
+      buffered = m_buffer.snapshot();
+    }
+    if (m_root != nullptr) {
+      m_root->knn(target, heap, filter);
+    }
+  }
+  // Inserts keep appending meanwhile
+  buffered.knn(target, heap, filter);
 
-template class SSTree<7>;
-template class SSNode<7>;
+  return heap.take_sorted();
+}
 
-template class SSTree<11>;
-template class SSNode<11>;
+/**
+ * range
+ * Busca todos los datos a menos de `radius` de un punto, en el árbol y en
+ * una instantánea del buffer de escritura.
+ * @param target Punto de consulta.
+ * @param radius Radio de la consulta.
+ * @param filter Restringe el resultado a los datos elegibles.
+ * @return std::vector<Neighbor>: Datos encontrados ordenados por distancia.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto SSTree<MAX_POINTS_PER_NODE>::range(const Point &target, float radius,
+                                        const SearchFilter &filter) const
+    -> std::vector<Neighbor> {
+  std::vector<Neighbor> result;
+
+  WriteBuffer::Snapshot buffered;
+  {
+    std::shared_lock tree_lock(m_tree_mutex);
+    {
+      std::scoped_lock buffer_lock(m_buffer_mutex);
+      buffered = m_buffer.snapshot();
+    }
+    if (m_root != nullptr) {
+      m_root->range(target, radius, result, filter);
+    }
+  }
+  // Inserts keep appending meanwhile
+  buffered.range(target, radius, result, filter);
+
+  std::ranges::sort(result, {}, &Neighbor::distance);
+  return result;
+}
+
+// Explicit instantiation
+#define SSTREE_INSTANTIATE(N)                                                  \
+  template class SSTree<N>;                                                    \
+  template class SSNode<N>;
+SSTREE_FOR_EACH_CAPACITY(SSTREE_INSTANTIATE)
+#undef SSTREE_INSTANTIATE
@@ -0,0 +1,93 @@
+#include "SearchFilter.hpp"
+
+#include <bit>
+#include <utility>
+
+void IdBitmap::set(uint64_t id) {
+  if (id / WORD_BITS >= m_words.size()) {
+    m_words.resize(id / WORD_BITS + 1, 0);
+  }
+  m_words[id / WORD_BITS] |= uint64_t{1} << (id % WORD_BITS);
+}
+
+void IdBitmap::reset(uint64_t id) {
+  if (id / WORD_BITS < m_words.size()) {
+    m_words[id / WORD_BITS] &= ~(uint64_t{1} << (id % WORD_BITS));
+  }
+}
+
+auto IdBitmap::test(uint64_t id) const -> bool {
+  return id / WORD_BITS < m_words.size() &&
+         (m_words[id / WORD_BITS] >> (id % WORD_BITS) & 1U) != 0;
+}
+
+SearchFilter::SearchFilter(IdBitmap allowed_ids)
+    : m_allowed_ids(std::move(allowed_ids)) {
+  count_allowed_ids();
+}
+
+SearchFilter::SearchFilter(std::function<bool(const Data &)> predicate)
+    : m_predicate(std::move(predicate)) {}
+
+SearchFilter::SearchFilter(IdBitmap allowed_ids,
+                           std::function<bool(const Data &)> predicate)
+    : m_allowed_ids(std::move(allowed_ids)), m_predicate(std::move(predicate)) {
+  count_allowed_ids();
+}
+
+// Prefix counts over the words, so any id range is checked in O(1)
+void SearchFilter::count_allowed_ids() {
+  const auto &words = m_allowed_ids->get_words();
+  m_allowed_before.assign(words.size() + 1, 0);
+  for (size_t word = 0; word < words.size(); ++word) {
+    m_allowed_before[word + 1] = m_allowed_before[word] +
+                                 static_cast<uint64_t>(std::popcount(words[word]));
+  }
+}
+
+auto SearchFilter::allowed_through(uint64_t id) const -> uint64_t {
+  const auto &words = m_allowed_ids->get_words();
+  auto word = id / IdBitmap::WORD_BITS;
+  if (word >= words.size()) {
+    return m_allowed_before.back();
+  }
+  auto bit = id % IdBitmap::WORD_BITS;
+  // Bits 0..bit of the word, without shifting by 64
+  auto mask = bit + 1 == IdBitmap::WORD_BITS
+                  ? ~uint64_t{0}
+                  : (uint64_t{1} << (bit + 1)) - 1;
+  return m_allowed_before[word] +
+         static_cast<uint64_t>(std::popcount(words[word] & mask));
+}
+
+/**
+ * mayContain
+ * Verifica si el bitmap permite algún id del rango de un nodo. Sin bitmap
+ * cualquier nodo no vacío puede tener entradas elegibles.
+ * @param ids Rango de ids guardados bajo el nodo.
+ * @return bool - false si el nodo puede descartarse sin visitarlo.
+ */
+auto SearchFilter::may_contain(const IdRange &ids) const -> bool {
+  if (ids.empty()) {
+    return false;
+  }
+  if (!m_allowed_ids) {
+    return true;
+  }
+  auto before = ids.min == 0 ? 0 : allowed_through(ids.min - 1);
+  return allowed_through(ids.max) > before;
+}
+
+/**
+ * accepts
+ * Verifica si un dato es elegible: su id debe estar en el bitmap (si hay uno)
+ * y debe cumplir el predicado (si hay uno).
+ * @param data Dato a verificar.
+ * @return bool - true si el dato puede formar parte del resultado.
+ */
+auto SearchFilter::accepts(const Data &data) const -> bool {
+  if (m_allowed_ids && !m_allowed_ids->test(data.get_id())) {
+    return false;
+  }
+  return !m_predicate || m_predicate(data);
+}
@@ -0,0 +1,186 @@
+#include "ShardedSSTree.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "KMeans.hpp"
+
+template <size_t MAX_POINTS_PER_NODE>
+ShardedSSTree<MAX_POINTS_PER_NODE>::ShardedSSTree(const ShardOptions &options)
+    : m_options(options) {
+  auto num_shards = std::max<size_t>(m_options.num_shards, 1);
+  m_options.readers_per_shard = std::max<size_t>(m_options.readers_per_shard, 1);
+  m_shards.resize(num_shards);
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    auto cpus = shard < m_options.shard_cpus.size()
+                    ? m_options.shard_cpus[shard]
+                    : std::vector<size_t>{};
+    m_writers.push_back(std::make_unique<WorkerThread>(cpus));
+    for (size_t reader = 0; reader < m_options.readers_per_shard; ++reader) {
+      m_readers.push_back(std::make_unique<WorkerThread>(cpus));
+    }
+  }
+  // Built on the pinned writers, so the shard's buffer (and its flush
+  // thread, which inherits the affinity) start on the shard's CPUs
+  run_on_every_shard([this](size_t shard) {
+    m_shards[shard] = std::make_unique<Shard>(m_options.buffer_options);
+  });
+}
+
+/**
+ * runOnEveryShard
+ * Ejecuta una tarea en el hilo escritor de cada shard y espera a que todas
+ * terminen.
+ * @param task Tarea, recibe el índice del shard.
+ * @throws La primera excepción lanzada por alguna tarea.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void ShardedSSTree<MAX_POINTS_PER_NODE>::run_on_every_shard(
+    const std::function<void(size_t)> &task) const {
+  auto num_shards = m_writers.size();
+  std::vector<std::exception_ptr> errors(num_shards);
+  std::latch done(static_cast<std::ptrdiff_t>(num_shards));
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    m_writers[shard]->post([&, shard] {
+      try {
+        task(shard);
+      } catch (...) {
+        errors[shard] = std::current_exception();
+      }
+      done.count_down();
+    });
+  }
+  done.wait();
+
+  for (const auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+/**
+ * shardFor
+ * Elige el shard de un dato: el del centroide más cercano si la partición es
+ * por clusters y está entrenada, o por hash de la ruta en otro caso.
+ * @param data Dato a ubicar.
+ * @return size_t: Índice del shard.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto ShardedSSTree<MAX_POINTS_PER_NODE>::shard_for(const Data &data) const
+    -> size_t {
+  if (m_options.partitioning == ShardPartitioning::CLUSTER &&
+      !m_shard_centroids.empty()) {
+    return nearest_centroid(m_shard_centroids, data.get_embedding());
+  }
+  return std::hash<std::string>{}(data.get_path()) % m_shards.size();
+}
+
+/**
+ * trainPartitioning
+ * k-means (k = número de shards) sobre una muestra para obtener un centroide
+ * por shard.
+ * @param sample Puntos de entrenamiento (al menos uno por shard).
+ * @param iterations Iteraciones de k-means.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void ShardedSSTree<MAX_POINTS_PER_NODE>::train_partitioning(
+    const std::vector<Point> &sample, size_t iterations) {
+  m_shard_centroids = kmeans(sample, m_shards.size(), iterations);
+}
+
+/**
+ * insert
+ * Encola la inserción en el hilo escritor del shard elegido y retorna sin
+ * esperarla, de modo que los nodos y datos del shard se crean en su nodo
+ * NUMA. Un error se reporta en el siguiente flush().
+ * @param data Dato a insertar.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void ShardedSSTree<MAX_POINTS_PER_NODE>::insert(
+    const std::shared_ptr<Data> &data) {
+  auto shard = shard_for(*data);
+  m_writers[shard]->post([this, shard, data] {
+    try {
+      m_shards[shard]->insert(data);
+    } catch (...) {
+      std::scoped_lock lock(m_insert_error_mutex);
+      if (!m_insert_error) {
+        m_insert_error = std::current_exception();
+      }
+    }
+  });
+}
+
+// Waits for every queued insert, then flushes each shard on its writer
+template <size_t MAX_POINTS_PER_NODE>
+void ShardedSSTree<MAX_POINTS_PER_NODE>::flush() {
+  run_on_every_shard([this](size_t shard) { m_shards[shard]->flush(); });
+
+  std::scoped_lock lock(m_insert_error_mutex);
+  if (m_insert_error) {
+    std::rethrow_exception(std::exchange(m_insert_error, nullptr));
+  }
+}
+
+/**
+ * knn
+ * Lanza la búsqueda en todos los shards en paralelo, cada una en el siguiente
+ * hilo lector de su shard, con una cota compartida, y mezcla los resultados.
+ * @param target Punto de consulta.
+ * @param k Número de vecinos.
+ * @param filter Restringe el resultado a los datos elegibles.
+ * @return std::vector<Neighbor>: Vecinos ordenados por distancia.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto ShardedSSTree<MAX_POINTS_PER_NODE>::knn(const Point &target, size_t k,
+                                             const SearchFilter &filter) const
+    -> std::vector<Neighbor> {
+  auto num_shards = m_shards.size();
+  std::atomic<float> shared_bound{std::numeric_limits<float>::max()};
+  std::vector<std::vector<Neighbor>> results(num_shards);
+  std::vector<std::exception_ptr> errors(num_shards);
+  std::latch done(static_cast<std::ptrdiff_t>(num_shards));
+
+  // Consecutive queries go to different readers of each shard
+  auto reader = m_next_reader.fetch_add(1, std::memory_order_relaxed) %
+                m_options.readers_per_shard;
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    m_readers[(shard * m_options.readers_per_shard) + reader]->post([&, shard] {
+      try {
+        results[shard] = m_shards[shard]->knn(target, k, filter, &shared_bound);
+      } catch (...) {
+        errors[shard] = std::current_exception();
+      }
+      done.count_down();
+    });
+  }
+  done.wait();
+
+  for (const auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  NeighborHeap heap(k);
+  for (const auto &result : results) {
+    for (const auto &neighbor : result) {
+      heap.push(neighbor.distance, neighbor.data);
+    }
+  }
+  return heap.take_sorted();
+}
+
+// Explicit instantiation
+#define SSTREE_INSTANTIATE_SHARDED(N) template class ShardedSSTree<N>;
+SSTREE_FOR_EACH_CAPACITY(SSTREE_INSTANTIATE_SHARDED)
+#undef SSTREE_INSTANTIATE_SHARDED
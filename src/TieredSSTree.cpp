@@ -0,0 +1,527 @@
+#include "TieredSSTree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+
+#include "Dataset.hpp"
+#include "KMeans.hpp"
+
+namespace {
+
+constexpr std::array<char, 4> METADATA_MAGIC = {'S', 'S', 'T', 'M'};
+constexpr uint64_t METADATA_VERSION = 2;
+
+// kNN candidate; its embedding stays in the leaf's page until the final k
+// are known
+struct LeafEntry {
+  float distance;
+  size_t leaf; // Index into m_nodes
+  size_t slot; // Row within the leaf's page
+};
+
+template <typename T> void write_value(std::ofstream &file, const T &value) {
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+void write_values(std::ofstream &file, std::span<const T> values) {
+  write_value(file, static_cast<uint64_t>(values.size()));
+  file.write(reinterpret_cast<const char *>(values.data()),
+             static_cast<std::streamsize>(values.size_bytes()));
+}
+
+template <typename T> auto read_value(std::ifstream &file) -> T {
+  T value{};
+  file.read(reinterpret_cast<char *>(&value), sizeof(T));
+  return value;
+}
+
+template <typename T>
+void read_values(std::ifstream &file, std::vector<T> &values) {
+  values.resize(read_value<uint64_t>(file));
+  file.read(reinterpret_cast<char *>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+/**
+ * centroidOf
+ * Centroide (promedio) de un conjunto de entradas.
+ * @param entries Coordenadas de cada entrada (DIM floats).
+ * @return Point: El centroide.
+ */
+auto centroid_of(const std::vector<const float *> &entries) -> Point {
+  std::array<float, DIM> sums{};
+  for (const auto *entry : entries) {
+    std::transform(sums.begin(), sums.end(), entry, sums.begin(),
+                   std::plus<>());
+  }
+  return Point(sums) / static_cast<float>(entries.size());
+}
+
+// Visits the centroids greedily, always moving to the closest unvisited
+// one, so consecutive clusters tend to be close to each other
+auto chain_order(const std::vector<Point> &centroids) -> std::vector<size_t> {
+  std::vector<size_t> order(centroids.size());
+  std::iota(order.begin(), order.end(), 0);
+  for (size_t i = 1; i < order.size(); ++i) {
+    const Point &last = centroids[order[i - 1]];
+    auto closest = std::ranges::min_element(
+        order.begin() + static_cast<int64_t>(i), order.end(), {},
+        [&](size_t cluster) {
+          return Point::squared_distance(last.data(),
+                                         centroids[cluster].data());
+        });
+    std::iter_swap(order.begin() + static_cast<int64_t>(i), closest);
+  }
+  return order;
+}
+
+} // namespace
+
+template <size_t MAX_POINTS_PER_NODE>
+TieredSSTree<MAX_POINTS_PER_NODE>::TieredSSTree(
+    const std::string &page_file_path, PageFileMode mode, size_t pool_frames,
+    size_t prefetch_depth)
+    : m_page_file_path(page_file_path),
+      m_page_file(page_file_path, MAX_POINTS_PER_NODE * DIM, mode),
+      m_pool(m_page_file, pool_frames), m_prefetch_depth(prefetch_depth) {}
+
+template <size_t MAX_POINTS_PER_NODE>
+TieredSSTree<MAX_POINTS_PER_NODE>::TieredSSTree(
+    SSTree<MAX_POINTS_PER_NODE> &tree, const std::string &page_file_path,
+    size_t pool_frames, size_t prefetch_depth)
+    : TieredSSTree(page_file_path, PageFileMode::CREATE, pool_frames,
+                   prefetch_depth) {
+  tree.flush();
+  if (tree.get_root() != nullptr) {
+    std::vector<float> page(m_page_file.get_page_floats());
+    m_root = copy_subtree(tree.get_root(), page);
+  }
+  save_metadata();
+}
+
+/**
+ * build
+ * Construye el índice leyendo el dataset por partes. Primero entrena k-means
+ * con las primeras sample_size filas; después asigna cada punto al centroide
+ * más cercano y lo agrega a la hoja abierta de ese grupo, que se escribe en
+ * disco al llenarse. Los nodos internos se forman de abajo hacia arriba
+ * agrupando MAX_POINTS_PER_NODE nodos consecutivos, con las hojas de cada
+ * grupo juntas y los grupos en orden de cercanía.
+ * @param dataset_path Archivo escrito por Dataset::save.
+ * @param page_file_path Archivo de páginas a crear.
+ * @param pool_frames Marcos del buffer pool.
+ * @param options Parámetros de la construcción.
+ * @return std::unique_ptr<TieredSSTree>: Índice construido y guardado.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto TieredSSTree<MAX_POINTS_PER_NODE>::build(
+    const std::string &dataset_path, const std::string &page_file_path,
+    size_t pool_frames, const TieredBuildOptions &options)
+    -> std::unique_ptr<TieredSSTree> {
+  std::unique_ptr<TieredSSTree> tree(
+      new TieredSSTree(page_file_path, PageFileMode::CREATE, pool_frames,
+                       options.prefetch_depth));
+  DatasetReader reader(dataset_path);
+  if (reader.size() == 0) {
+    tree->save_metadata();
+    return tree;
+  }
+
+  std::vector<float> chunk;
+  std::vector<Point> centroids;
+  {
+    auto sample_size =
+        reader.read(std::max<size_t>(options.sample_size, 1), chunk);
+    std::vector<Point> sample;
+    std::array<float, DIM> coordinates{};
+    for (size_t i = 0; i < sample_size; ++i) {
+      std::copy_n(chunk.begin() + static_cast<int64_t>(i * DIM), DIM,
+                  coordinates.begin());
+      sample.emplace_back(coordinates);
+    }
+    centroids =
+        kmeans(sample, std::clamp<size_t>(options.num_clusters, 1, sample_size),
+               options.kmeans_iterations);
+  }
+  reader.rewind();
+
+  struct OpenLeaf {
+    std::vector<float> page;
+    std::vector<std::string> paths;
+    std::vector<uint64_t> ids;
+  };
+  std::vector<OpenLeaf> open_leaves(centroids.size());
+  std::vector<std::vector<size_t>> cluster_leaves(centroids.size());
+  auto page_floats = tree->m_page_file.get_page_floats();
+
+  std::array<float, DIM> coordinates{};
+  while (auto count = reader.read(std::max<size_t>(options.chunk_size, 1),
+                                  chunk)) {
+    auto first_index = reader.position() - count;
+    for (size_t i = 0; i < count; ++i) {
+      const float *row = chunk.data() + i * DIM;
+      std::copy_n(row, DIM, coordinates.begin());
+      auto cluster = nearest_centroid(centroids, Point(coordinates));
+
+      auto &leaf = open_leaves[cluster];
+      leaf.page.resize(page_floats);
+      std::copy_n(row, DIM,
+                  leaf.page.begin() +
+                      static_cast<int64_t>(leaf.paths.size() * DIM));
+      leaf.paths.push_back(Dataset::point_path(first_index + i));
+      leaf.ids.push_back(first_index + i);
+      if (leaf.paths.size() == MAX_POINTS_PER_NODE) {
+        cluster_leaves[cluster].push_back(tree->add_leaf(
+            leaf.page, std::move(leaf.paths), std::move(leaf.ids)));
+        leaf.paths.clear();
+        leaf.ids.clear();
+      }
+    }
+  }
+
+  std::vector<size_t> level;
+  for (auto cluster : chain_order(centroids)) {
+    auto &leaf = open_leaves[cluster];
+    if (!leaf.paths.empty()) {
+      cluster_leaves[cluster].push_back(tree->add_leaf(
+          leaf.page, std::move(leaf.paths), std::move(leaf.ids)));
+    }
+    level.insert(level.end(), cluster_leaves[cluster].begin(),
+                 cluster_leaves[cluster].end());
+  }
+
+  while (level.size() > 1) {
+    std::vector<size_t> parents;
+    for (size_t first = 0; first < level.size();
+         first += MAX_POINTS_PER_NODE) {
+      auto last = std::min(first + MAX_POINTS_PER_NODE, level.size());
+      parents.push_back(tree->add_internal(
+          {level.begin() + static_cast<int64_t>(first),
+           level.begin() + static_cast<int64_t>(last)}));
+    }
+    level = std::move(parents);
+  }
+  tree->m_root = level.front();
+
+  tree->save_metadata();
+  return tree;
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+auto TieredSSTree<MAX_POINTS_PER_NODE>::open(const std::string &page_file_path,
+                                             size_t pool_frames,
+                                             size_t prefetch_depth)
+    -> std::unique_ptr<TieredSSTree> {
+  std::unique_ptr<TieredSSTree> tree(new TieredSSTree(
+      page_file_path, PageFileMode::OPEN, pool_frames, prefetch_depth));
+  tree->load_metadata();
+  return tree;
+}
+
+/**
+ * copySubtree
+ * Copia un subárbol del SSTree: los nodos quedan en memoria y los embeddings
+ * de cada hoja se escriben en su propia página.
+ * @param node Raíz del subárbol a copiar.
+ * @param page Buffer de una página, reutilizado entre hojas.
+ * @return size_t: Índice del nodo creado en m_nodes.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto TieredSSTree<MAX_POINTS_PER_NODE>::copy_subtree(
+    const std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> &node,
+    std::vector<float> &page) -> size_t {
+  if (node->get_is_leaf()) {
+    std::vector<std::string> paths;
+    std::vector<uint64_t> ids;
+    auto *row = page.data();
+    for (const auto &data : node->get_data()) {
+      std::copy_n(data->get_embedding().data(), DIM, row);
+      row += DIM;
+      paths.push_back(data->get_path());
+      ids.push_back(data->get_id());
+    }
+    return add_leaf(page, std::move(paths), std::move(ids));
+  }
+
+  std::vector<size_t> children;
+  for (const auto &child : node->get_children()) {
+    children.push_back(copy_subtree(child, page));
+  }
+  return add_internal(std::move(children));
+}
+
+/**
+ * addLeaf
+ * Escribe la página de una hoja y agrega su nodo (centroide, radio,
+ * distancias de cada entrada y metadatos) a m_nodes.
+ * @param page Página con una fila por entrada; se completa con ceros.
+ * @param paths Ruta de cada entrada.
+ * @param ids Id de cada entrada.
+ * @return size_t: Índice del nodo creado en m_nodes.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto TieredSSTree<MAX_POINTS_PER_NODE>::add_leaf(
+    std::vector<float> &page, std::vector<std::string> paths,
+    std::vector<uint64_t> ids) -> size_t {
+  auto num_entries = paths.size();
+  std::fill(page.begin() + static_cast<int64_t>(num_entries * DIM), page.end(),
+            0.0F);
+
+  Node leaf;
+  leaf.page_id = m_num_leaves++;
+  std::vector<const float *> rows;
+  for (size_t i = 0; i < num_entries; ++i) {
+    rows.push_back(page.data() + i * DIM);
+  }
+  leaf.centroid = centroid_of(rows);
+  for (const auto *row : rows) {
+    leaf.entry_distances.push_back(
+        std::sqrt(Point::squared_distance(row, leaf.centroid.data())));
+  }
+  leaf.radius = std::ranges::max(leaf.entry_distances);
+  leaf.paths = std::move(paths);
+  leaf.ids = std::move(ids);
+
+  m_page_file.write_page(leaf.page_id, page.data());
+  m_nodes.push_back(std::move(leaf));
+  return m_nodes.size() - 1;
+}
+
+/**
+ * addInternal
+ * Agrega un nodo interno cuya esfera encierra las de sus hijos.
+ * @param children Índices de los hijos en m_nodes.
+ * @return size_t: Índice del nodo creado en m_nodes.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto TieredSSTree<MAX_POINTS_PER_NODE>::add_internal(
+    std::vector<size_t> children) -> size_t {
+  Node node;
+  std::vector<const float *> centroids;
+  for (auto child : children) {
+    centroids.push_back(m_nodes[child].centroid.data());
+  }
+  node.centroid = centroid_of(centroids);
+  for (auto child : children) {
+    auto distance = Point::distance(m_nodes[child].centroid, node.centroid);
+    node.entry_distances.push_back(distance);
+    node.radius = std::max(node.radius, distance + m_nodes[child].radius);
+  }
+  node.children = std::move(children);
+
+  m_nodes.push_back(std::move(node));
+  return m_nodes.size() - 1;
+}
+
+/**
+ * saveMetadata
+ * Vacía el archivo de páginas y guarda la parte en memoria del índice (nodos,
+ * rutas e ids) en metadata_path, junto a él. Las páginas quedan escritas antes
+ * que los metadatos que las referencian.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+void TieredSSTree<MAX_POINTS_PER_NODE>::save_metadata() {
+  m_page_file.flush();
+  auto path = metadata_path(m_page_file_path);
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(METADATA_MAGIC.data(), METADATA_MAGIC.size());
+  write_value(file, METADATA_VERSION);
+  write_value(file, static_cast<uint64_t>(MAX_POINTS_PER_NODE));
+  write_value(file, static_cast<uint64_t>(DIM));
+  write_value(file, static_cast<uint64_t>(m_root));
+  write_value(file, static_cast<uint64_t>(m_num_leaves));
+  write_value(file, static_cast<uint64_t>(m_nodes.size()));
+
+  for (const auto &node : m_nodes) {
+    file.write(reinterpret_cast<const char *>(node.centroid.data()),
+               DIM * sizeof(float));
+    write_value(file, node.radius);
+    write_value(file, node.page_id);
+    std::vector<uint64_t> children(node.children.begin(), node.children.end());
+    write_values<uint64_t>(file, children);
+    write_values<float>(file, node.entry_distances);
+    write_values<uint64_t>(file, node.ids);
+    for (const auto &node_path : node.paths) {
+      write_values<char>(file, node_path);
+    }
+  }
+  if (!file) {
+    throw std::runtime_error("Cannot write index metadata: " + path);
+  }
+}
+
+template <size_t MAX_POINTS_PER_NODE>
+void TieredSSTree<MAX_POINTS_PER_NODE>::load_metadata() {
+  auto path = metadata_path(m_page_file_path);
+  std::ifstream file(path, std::ios::binary);
+  std::array<char, METADATA_MAGIC.size()> magic{};
+  file.read(magic.data(), magic.size());
+  if (!file || magic != METADATA_MAGIC ||
+      read_value<uint64_t>(file) != METADATA_VERSION ||
+      read_value<uint64_t>(file) != MAX_POINTS_PER_NODE ||
+      read_value<uint64_t>(file) != DIM) {
+    throw std::runtime_error("Invalid index metadata: " + path);
+  }
+  m_root = read_value<uint64_t>(file);
+  m_num_leaves = read_value<uint64_t>(file);
+  m_nodes.resize(read_value<uint64_t>(file));
+
+  std::array<float, DIM> coordinates{};
+  std::vector<uint64_t> children;
+  for (auto &node : m_nodes) {
+    file.read(reinterpret_cast<char *>(coordinates.data()),
+              DIM * sizeof(float));
+    node.centroid = Point(coordinates);
+    node.radius = read_value<float>(file);
+    node.page_id = read_value<uint64_t>(file);
+    read_values(file, children);
+    node.children.assign(children.begin(), children.end());
+    read_values(file, node.entry_distances);
+    read_values(file, node.ids);
+    node.paths.resize(node.ids.size());
+    std::vector<char> node_path;
+    for (auto &entry_path : node.paths) {
+      read_values(file, node_path);
+      entry_path.assign(node_path.begin(), node_path.end());
+    }
+  }
+  if (!file || (!m_nodes.empty() && m_root >= m_nodes.size())) {
+    throw std::runtime_error("Truncated index metadata: " + path);
+  }
+}
+
+/**
+ * knn
+ * Busca los k datos más cercanos (best-first, igual que SSNode::knn).
+ * Antes de recorrer una hoja se piden al pool las siguientes hojas de la
+ * frontera, de modo que su lectura se solapa con el cálculo de distancias.
+ * Los candidatos se guardan como (distancia, hoja, fila); solo los k finales
+ * se vuelven a leer de su página para construir sus Data.
+ * @param target Punto de consulta.
+ * @param k Número de vecinos.
+ * @return std::vector<Neighbor>: Vecinos ordenados por distancia.
+ */
+template <size_t MAX_POINTS_PER_NODE>
+auto TieredSSTree<MAX_POINTS_PER_NODE>::knn(const Point &target,
+                                            size_t k) const
+    -> std::vector<Neighbor> {
+  if (m_nodes.empty() || k == 0) {
+    return {};
+  }
+
+  // Max-heap with the k closest entries found so far
+  std::vector<LeafEntry> best;
+  best.reserve(k + 1);
+  auto worst_distance = [&best, k] {
+    return best.size() < k ? std::numeric_limits<float>::max()
+                           : best.front().distance;
+  };
+
+  // (lower bound of the subtree, distance from target to centroid, node)
+  using frontier_entry = std::tuple<float, float, size_t>;
+  std::vector<frontier_entry> frontier;
+  std::vector<frontier_entry> upcoming_leaves;
+
+  auto push = [&frontier](float bound, float centroid_distance, size_t node) {
+    frontier.emplace_back(bound, centroid_distance, node);
+    std::ranges::push_heap(frontier, std::greater<>());
+  };
+
+  const Node &root = m_nodes[m_root];
+  auto root_distance = Point::distance(root.centroid, target);
+  push(std::max(0.0F, root_distance - root.radius), root_distance, m_root);
+
+  while (!frontier.empty()) {
+    std::ranges::pop_heap(frontier, std::greater<>());
+    auto [node_distance, centroid_distance, index] = frontier.back();
+    frontier.pop_back();
+
+    if (node_distance >= worst_distance()) {
+      break;
+    }
+    const Node &node = m_nodes[index];
+
+    if (!node.is_leaf()) {
+      for (size_t i = 0; i < node.children.size(); ++i) {
+        const Node &child = m_nodes[node.children[i]];
+        if (std::abs(centroid_distance - node.entry_distances[i]) -
+                child.radius >=
+            worst_distance()) {
+          continue;
+        }
+        auto reach = worst_distance() + child.radius;
+        auto squared = Point::bounded_squared_distance(
+            child.centroid.data(), target.data(), reach * reach);
+        if (squared < reach * reach) {
+          auto child_distance = std::sqrt(squared);
+          push(std::max(0.0F, child_distance - child.radius), child_distance,
+               node.children[i]);
+        }
+      }
+      continue;
+    }
+
+    // Prefetch the closest leaves still waiting in the frontier
+    upcoming_leaves.clear();
+    std::ranges::copy_if(frontier, std::back_inserter(upcoming_leaves),
+                         [this](const auto &entry) {
+                           return m_nodes[std::get<2>(entry)].is_leaf();
+                         });
+    auto num_prefetch = std::min(m_prefetch_depth, upcoming_leaves.size());
+    std::ranges::partial_sort(upcoming_leaves,
+                              upcoming_leaves.begin() +
+                                  static_cast<int64_t>(num_prefetch));
+    for (size_t i = 0; i < num_prefetch; ++i) {
+      m_pool.prefetch(m_nodes[std::get<2>(upcoming_leaves[i])].page_id);
+    }
+
+    auto page = m_pool.pin(node.page_id);
+    const float *row = page.data();
+    for (size_t i = 0; i < node.paths.size(); ++i, row += DIM) {
+      auto worst = worst_distance();
+      if (std::abs(centroid_distance - node.entry_distances[i]) >= worst) {
+        continue;
+      }
+      auto squared = Point::bounded_squared_distance(row, target.data(),
+                                                     worst * worst);
+      if (squared >= worst * worst) {
+        continue;
+      }
+      best.push_back({std::sqrt(squared), index, i});
+      std::ranges::push_heap(best, {}, &LeafEntry::distance);
+      if (best.size() > k) {
+        std::ranges::pop_heap(best, {}, &LeafEntry::distance);
+        best.pop_back();
+      }
+    }
+  }
+
+  std::ranges::sort_heap(best, {}, &LeafEntry::distance);
+  std::vector<Neighbor> result;
+  result.reserve(best.size());
+  std::array<float, DIM> coordinates{};
+  for (const auto &entry : best) {
+    const Node &leaf = m_nodes[entry.leaf];
+    auto page = m_pool.pin(leaf.page_id);
+    std::copy_n(page.data() + (entry.slot * DIM), DIM, coordinates.begin());
+    result.push_back({entry.distance,
+                      std::make_shared<Data>(Point(coordinates),
+                                             leaf.paths[entry.slot],
+                                             leaf.ids[entry.slot])});
+  }
+  return result;
+}
+
+// Explicit instantiation
+#define SSTREE_INSTANTIATE_TIERED(N) template class TieredSSTree<N>;
+SSTREE_FOR_EACH_CAPACITY(SSTREE_INSTANTIATE_TIERED)
+#undef SSTREE_INSTANTIATE_TIERED
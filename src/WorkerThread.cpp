@@ -0,0 +1,50 @@
+#include "WorkerThread.hpp"
+
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+WorkerThread::WorkerThread(const std::vector<size_t> &cpus)
+    : m_thread([this](const std::stop_token &stop_token) { run(stop_token); }) {
+#ifdef __linux__
+  if (!cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    // Best effort: an invalid set leaves the thread unpinned
+    pthread_setaffinity_np(m_thread.native_handle(), sizeof(cpu_set),
+                           &cpu_set);
+  }
+#else
+  static_cast<void>(cpus);
+#endif
+}
+
+void WorkerThread::post(std::function<void()> task) {
+  {
+    std::scoped_lock lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_tasks_cv.notify_one();
+}
+
+/**
+ * run
+ * Ejecuta las tareas en orden hasta que se pida la parada.
+ * @param stop_token Señal de parada enviada al destruir el hilo.
+ */
+void WorkerThread::run(const std::stop_token &stop_token) {
+  std::unique_lock lock(m_mutex);
+  while (m_tasks_cv.wait(lock, stop_token, [this] { return !m_tasks.empty(); })) {
+    auto task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
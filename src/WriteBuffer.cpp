@@ -0,0 +1,116 @@
+#include "WriteBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * append
+ * Agrega un dato al final del buffer copiando su embedding a la siguiente
+ * ranura libre, y reserva un bloque nuevo cuando el último se llena.
+ * @param data Dato a agregar.
+ */
+void WriteBuffer::append(const std::shared_ptr<Data> &data) {
+  auto slot = m_head + m_size;
+  if (slot == m_chunks.size() * CHUNK_SIZE) {
+    // Slots are written before they are read, no need to zero them
+    m_chunks.push_back(std::make_shared_for_overwrite<Chunk>());
+  }
+  auto &chunk = *m_chunks[slot / CHUNK_SIZE];
+  const float *coordinates = data->get_embedding().data();
+  std::copy_n(coordinates, DIM,
+              chunk.embeddings.begin() +
+                  static_cast<int64_t>((slot % CHUNK_SIZE) * DIM));
+  chunk.data.at(slot % CHUNK_SIZE) = data;
+  ++m_size;
+}
+
+void WriteBuffer::copy_front(size_t count,
+                             std::vector<std::shared_ptr<Data>> &out) const {
+  count = std::min(count, m_size);
+  out.clear();
+  for (size_t slot = m_head; slot < m_head + count; ++slot) {
+    out.push_back(m_chunks[slot / CHUNK_SIZE]->data.at(slot % CHUNK_SIZE));
+  }
+}
+
+/**
+ * eraseFront
+ * Elimina las `count` entradas más antiguas del buffer. Solo avanza m_head y
+ * suelta los bloques que quedaron vacíos; ningún embedding se mueve.
+ * @param count Número de entradas a eliminar.
+ */
+void WriteBuffer::erase_front(size_t count) {
+  count = std::min(count, m_size);
+  m_head += count;
+  m_size -= count;
+
+  auto consumed = m_head / CHUNK_SIZE;
+  if (m_size == 0) {
+    // Every chunk is flushed, including a partly written last one
+    consumed = m_chunks.size();
+  }
+  m_chunks.erase(m_chunks.begin(),
+                 m_chunks.begin() + static_cast<int64_t>(consumed));
+  m_head = m_size == 0 ? 0 : m_head - (consumed * CHUNK_SIZE);
+}
+
+auto WriteBuffer::snapshot() const -> Snapshot {
+  Snapshot snapshot;
+  snapshot.m_chunks.assign(m_chunks.begin(), m_chunks.end());
+  snapshot.m_head = m_head;
+  snapshot.m_size = m_size;
+  return snapshot;
+}
+
+/**
+ * knn
+ * Recorre las entradas de la instantánea y agrega cada una elegible al heap
+ * de vecinos. Cada distancia se abandona en cuanto supera la k-ésima mejor.
+ * @param target Punto de consulta.
+ * @param heap Heap acotado con los k mejores vecinos encontrados.
+ * @param filter Filtro evaluado antes de calcular la distancia.
+ */
+void WriteBuffer::Snapshot::knn(const Point &target, NeighborHeap &heap,
+                                const SearchFilter &filter) const {
+  for (size_t slot = m_head; slot < m_head + m_size; ++slot) {
+    const auto &chunk = *m_chunks[slot / CHUNK_SIZE];
+    const auto &data = chunk.data.at(slot % CHUNK_SIZE);
+    if (!filter.accepts(*data)) {
+      continue;
+    }
+    auto worst = heap.worst_distance();
+    float squared = Point::bounded_squared_distance(
+        chunk.embeddings.data() + ((slot % CHUNK_SIZE) * DIM), target.data(),
+        worst * worst);
+    if (squared < worst * worst) {
+      heap.push(std::sqrt(squared), data);
+    }
+  }
+}
+
+/**
+ * range
+ * Recorre las entradas de la instantánea y agrega las elegibles a menos de
+ * `radius`.
+ * @param target Punto de consulta.
+ * @param radius Radio de la consulta.
+ * @param result Vector donde se agregan los datos encontrados.
+ * @param filter Filtro evaluado antes de calcular la distancia.
+ */
+void WriteBuffer::Snapshot::range(const Point &target, float radius,
+                                  std::vector<Neighbor> &result,
+                                  const SearchFilter &filter) const {
+  for (size_t slot = m_head; slot < m_head + m_size; ++slot) {
+    const auto &chunk = *m_chunks[slot / CHUNK_SIZE];
+    const auto &data = chunk.data.at(slot % CHUNK_SIZE);
+    if (!filter.accepts(*data)) {
+      continue;
+    }
+    float squared = Point::bounded_squared_distance(
+        chunk.embeddings.data() + ((slot % CHUNK_SIZE) * DIM), target.data(),
+        radius * radius);
+    if (squared < radius * radius) {
+      result.push_back({std::sqrt(squared), data});
+    }
+  }
+}
@@ -0,0 +1,294 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "Dataset.hpp"
+#include "QueryProtocol.hpp"
+
+namespace {
+
+constexpr std::string_view USAGE =
+    "Usage: SS_TREE_load --socket PATH [--connections C] [--requests R]\n"
+    "                    [--depth D] [--type knn|range] [--k K]\n"
+    "                    [--radius R] [--insert-percent P] [--seed S]\n"
+    "                    [--data-points N] [--data-seed S]\n";
+
+// Distinct queries per connection, generated before the clock starts
+constexpr size_t QUERY_POOL_SIZE = 256;
+// Ids of inserted points start here, away from the server's own data
+constexpr uint64_t FIRST_INSERT_ID = 1ULL << 40U;
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadConfig {
+  std::string socket_path;
+  size_t num_connections = 4;
+  size_t requests_per_connection = 1000;
+  size_t depth = 8; // Requests in flight per connection
+  RequestType type = RequestType::KNN;
+  uint32_t k = 10;
+  float radius = 1.0F;
+  uint64_t insert_percent = 0;
+  uint64_t seed = 7;
+  // Must match the server's --points and --seed: queries are new samples of
+  // the dataset it generated, so they land inside its clusters
+  size_t data_points = 10000;
+  uint64_t data_seed = 42;
+};
+
+auto parse_args(const std::vector<std::string_view> &args) -> LoadConfig {
+  LoadConfig config;
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (i + 1 == args.size()) {
+      throw std::invalid_argument("Missing value for " + std::string(args[i]));
+    }
+    auto flag = args[i];
+    std::string value(args[++i]);
+    if (flag == "--socket") {
+      config.socket_path = value;
+    } else if (flag == "--connections") {
+      config.num_connections = std::stoul(value);
+    } else if (flag == "--requests") {
+      config.requests_per_connection = std::stoul(value);
+    } else if (flag == "--depth") {
+      config.depth = std::max<size_t>(std::stoul(value), 1);
+    } else if (flag == "--type") {
+      if (value != "knn" && value != "range") {
+        throw std::invalid_argument("--type must be knn or range");
+      }
+      config.type = value == "knn" ? RequestType::KNN : RequestType::RANGE;
+    } else if (flag == "--k") {
+      config.k = static_cast<uint32_t>(std::stoul(value));
+    } else if (flag == "--radius") {
+      config.radius = std::stof(value);
+    } else if (flag == "--insert-percent") {
+      config.insert_percent = std::stoull(value);
+    } else if (flag == "--seed") {
+      config.seed = std::stoull(value);
+    } else if (flag == "--data-points") {
+      config.data_points = std::stoul(value);
+    } else if (flag == "--data-seed") {
+      config.data_seed = std::stoull(value);
+    } else {
+      throw std::invalid_argument("Unknown option " + std::string(flag));
+    }
+  }
+  if (config.socket_path.empty()) {
+    throw std::invalid_argument("--socket is required");
+  }
+  return config;
+}
+
+auto connect_to(const std::string &socket_path) -> int {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("Invalid socket path: " + socket_path);
+  }
+  std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&address),
+              sizeof(address)) == -1) {
+    auto error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "connect");
+  }
+  return fd;
+}
+
+void send_all(int fd, const std::vector<char> &bytes) {
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    auto written =
+        send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      throw std::system_error(errno, std::generic_category(), "send");
+    }
+    sent += static_cast<size_t>(written);
+  }
+}
+
+void receive_all(int fd, char *buffer, size_t size) {
+  size_t received = 0;
+  while (received < size) {
+    auto bytes = recv(fd, buffer + received, size - received, 0);
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    }
+    if (bytes == 0) {
+      throw std::runtime_error("Server closed the connection");
+    }
+    if (bytes == -1) {
+      throw std::system_error(errno, std::generic_category(), "recv");
+    }
+    received += static_cast<size_t>(bytes);
+  }
+}
+
+/**
+ * runConnection
+ * Envía los pedidos de una conexión manteniendo `depth` en vuelo y mide la
+ * latencia de cada uno, desde que se envía hasta que llega su respuesta.
+ * @param config Parámetros de la carga.
+ * @param connection Índice de la conexión (elige el flujo aleatorio).
+ * @return std::vector<double>: Latencias en microsegundos.
+ */
+auto run_connection(const LoadConfig &config, uint64_t connection)
+    -> std::vector<double> {
+  CounterRng rng(config.seed, connection);
+  DatasetOptions query_options;
+  query_options.num_points = QUERY_POOL_SIZE;
+  query_options.seed = config.data_seed;
+  query_options.num_threads = 1;
+  query_options.first_index =
+      config.data_points + (connection * QUERY_POOL_SIZE);
+  auto query_set = Dataset::generate(query_options);
+  std::vector<Point> queries;
+  for (size_t i = 0; i < QUERY_POOL_SIZE; ++i) {
+    queries.push_back(query_set.get_point(i));
+  }
+
+  int fd = connect_to(config.socket_path);
+  auto num_requests = config.requests_per_connection;
+  std::vector<Clock::time_point> sent_at(num_requests);
+  std::vector<double> latencies;
+  latencies.reserve(num_requests);
+  std::vector<char> message;
+  std::vector<char> payload;
+
+  auto send_request = [&](uint64_t request_id) {
+    Request request{.type = config.type,
+                    .request_id = request_id,
+                    .query = queries[request_id % QUERY_POOL_SIZE],
+                    .k = config.k,
+                    .radius = config.radius};
+    if (rng.next() % 100 < config.insert_percent) {
+      request.type = RequestType::INSERT;
+      request.id = FIRST_INSERT_ID + connection * num_requests + request_id;
+      request.path = "load_" + std::to_string(request.id) + ".jpg";
+    }
+    message.clear();
+    encode_request(request, message);
+    sent_at[request_id] = Clock::now();
+    send_all(fd, message);
+  };
+
+  try {
+    uint64_t next_request = 0;
+    for (; next_request < std::min(config.depth, num_requests);
+         ++next_request) {
+      send_request(next_request);
+    }
+    for (size_t received = 0; received < num_requests; ++received) {
+      ResponseHeader header{};
+      receive_all(fd, reinterpret_cast<char *>(&header), sizeof(header));
+      payload.resize(header.payload_size);
+      receive_all(fd, payload.data(), payload.size());
+      if (header.status != ResponseStatus::OK ||
+          header.request_id >= num_requests) {
+        throw std::runtime_error("Request " +
+                                 std::to_string(header.request_id) +
+                                 " failed");
+      }
+      latencies.push_back(std::chrono::duration<double, std::micro>(
+                              Clock::now() - sent_at[header.request_id])
+                              .count());
+      if (next_request < num_requests) {
+        send_request(next_request++);
+      }
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+  return latencies;
+}
+
+auto percentile(const std::vector<double> &sorted, double fraction)
+    -> double {
+  auto index = static_cast<size_t>(fraction *
+                                   static_cast<double>(sorted.size() - 1));
+  return sorted[index];
+}
+
+} // namespace
+
+auto main(int argc, char *argv[]) -> int {
+  LoadConfig config;
+  try {
+    config = parse_args(std::vector<std::string_view>(argv + 1, argv + argc));
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n' << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::vector<double>> latencies(config.num_connections);
+  std::vector<std::exception_ptr> errors(config.num_connections);
+  auto start = Clock::now();
+  {
+    std::vector<std::jthread> clients;
+    for (size_t connection = 0; connection < config.num_connections;
+         ++connection) {
+      clients.emplace_back([&, connection] {
+        try {
+          latencies[connection] = run_connection(config, connection);
+        } catch (...) {
+          errors[connection] = std::current_exception();
+        }
+      });
+    }
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  for (const auto &error : errors) {
+    if (error) {
+      try {
+        std::rethrow_exception(error);
+      } catch (const std::exception &exception) {
+        std::cerr << exception.what() << '\n';
+      }
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<double> all;
+  for (const auto &connection_latencies : latencies) {
+    all.insert(all.end(), connection_latencies.begin(),
+               connection_latencies.end());
+  }
+  if (all.empty()) {
+    std::cout << "No requests sent\n";
+    return EXIT_SUCCESS;
+  }
+  std::ranges::sort(all);
+
+  std::cout << all.size() << " requests in " << elapsed.count() << " s ("
+            << static_cast<double>(all.size()) / elapsed.count()
+            << " requests/s)\n"
+            << "latency (us): p50 " << percentile(all, 0.5) << ", p90 "
+            << percentile(all, 0.9) << ", p99 " << percentile(all, 0.99)
+            << ", p99.9 " << percentile(all, 0.999) << ", max " << all.back()
+            << '\n';
+  return EXIT_SUCCESS;
+}
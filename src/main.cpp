@@ -1,31 +1,75 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <new>
+#include <ranges>
+#include <span>
 #include <unordered_set>
 #include <vector>
 
+#include "AnySSTree.hpp"
+#include "CapacityTuner.hpp"
 #include "Data.hpp"
+#include "Dataset.hpp"
 #include "Point.hpp"
+#include "Projection.hpp"
+#include "QueryProtocol.hpp"
 #include "SSTree.hpp"
+#include "SearchFilter.hpp"
+#include "ShardedSSTree.hpp"
+#include "TieredSSTree.hpp"
 
 constexpr size_t NUM_POINTS = 1000;
 constexpr size_t MAX_POINTS_PER_NODE = 20;
+constexpr size_t NUM_NEIGHBORS = 10;
+constexpr uint64_t DATASET_SEED = 42;
+constexpr float DISTANCE_TOLERANCE = 1e-3F;
+// CounterRng stream of the query points, apart from the dataset's streams
+constexpr uint64_t QUERY_STREAM = std::numeric_limits<uint64_t>::max();
+
+// Heap allocations made through operator new, counted for test 8
+std::atomic<size_t> allocation_count{0};
+
+auto operator new(size_t size) -> void * {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t /*size*/) noexcept {
+  std::free(pointer);
+}
 
 /*
  * Helper functions
  */
+inline auto generate_random_data_set(size_t num_points) -> Dataset {
+  return Dataset::generate({.distribution = Distribution::UNIFORM,
+                            .num_points = num_points,
+                            .seed = DATASET_SEED});
+}
+
 inline auto
 generate_random_data(size_t num_points) -> std::vector<std::shared_ptr<Data>> {
-  std::vector<std::shared_ptr<Data>> data;
-  for (size_t i = 0; i < num_points; ++i) {
-    Point embedding = Point::random();
-    std::string image_path = "image_" + std::to_string(i) + ".jpg";
-    std::shared_ptr<Data> data_point =
-        std::make_shared<Data>(embedding, image_path);
-    data.push_back(data_point);
-  }
-  return data;
+  return generate_random_data_set(num_points).to_data();
+}
+
+// Uniform query point from a seeded stream, so every check replays exactly
+inline auto random_query() -> Point {
+  static CounterRng rng(DATASET_SEED, QUERY_STREAM);
+  std::array<float, DIM> coordinates{};
+  std::ranges::generate(coordinates, [] { return rng.uniform(); });
+  return Point(coordinates);
 }
 
 inline void
@@ -43,6 +87,28 @@ collect_data_dfs(const std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> &node,
   }
 }
 
+inline auto
+count_nodes(const std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> &node)
+    -> size_t {
+  size_t count = 1;
+  for (const auto &child : node->get_children()) {
+    count += count_nodes(child);
+  }
+  return count;
+}
+
+// Numbers the entries leaf by leaf, in depth-first order
+inline void
+number_by_layout(const std::shared_ptr<SSNode<MAX_POINTS_PER_NODE>> &node,
+                 std::unordered_map<const Data *, uint64_t> &ids) {
+  for (const auto &data_point : node->get_data()) {
+    ids.emplace(data_point.get(), ids.size());
+  }
+  for (const auto &child : node->get_children()) {
+    number_by_layout(child, ids);
+  }
+}
+
 /*
  * Testing functions
  */
@@ -173,6 +239,372 @@ inline auto sphere_covers_all_children_spheres(
   return dfs_sphere_covers_all_children_spheres(root);
 }
 
+// Test 6: Check that kNN returns the same distances as a brute-force scan
+// over the entries accepted by the filter
+template <typename Tree>
+inline auto knn_matches_brute_force(
+    const Tree &tree,
+    const std::vector<std::shared_ptr<Data>> &data, size_t k,
+    const SearchFilter &filter = {}) -> bool {
+  auto query = random_query();
+
+  std::vector<float> expected;
+  std::ranges::transform(data | std::views::filter([&filter](const auto &d) {
+                           return filter.accepts(*d);
+                         }),
+                         std::back_inserter(expected),
+                         [&query](const auto &data_point) {
+                           return Point::distance(query,
+                                                  data_point->get_embedding());
+                         });
+  std::ranges::sort(expected);
+  expected.resize(std::min(k, expected.size()));
+
+  auto result = tree.knn(query, k, filter);
+
+  return result.size() == expected.size() &&
+         std::ranges::all_of(result,
+                             [&filter](const auto &neighbor) {
+                               return filter.accepts(*neighbor.data);
+                             }) &&
+         std::ranges::all_of(std::views::iota(0UL, result.size()),
+                             [&](size_t i) {
+                               return std::abs(result[i].distance -
+                                               expected[i]) <=
+                                      DISTANCE_TOLERANCE;
+                             });
+}
+
+// Test 7: Check that generated datasets only depend on the seed, survive a
+// round trip through disk, and can be continued from any point index
+inline auto dataset_is_reproducible() -> bool {
+  DatasetOptions options{.distribution = Distribution::GAUSSIAN_MIXTURE,
+                         .num_points = NUM_POINTS,
+                         .seed = DATASET_SEED,
+                         .num_threads = 1};
+  auto sequential = Dataset::generate(options);
+  options.num_threads = 4;
+  auto parallel = Dataset::generate(options);
+
+  auto path = (std::filesystem::temp_directory_path() / "sstree_dataset.bin")
+                  .string();
+  parallel.save(path);
+  auto loaded = Dataset::load(path);
+  std::filesystem::remove(path);
+
+  constexpr size_t CONTINUED_POINTS = 10;
+  options.first_index = NUM_POINTS - CONTINUED_POINTS;
+  options.num_points = CONTINUED_POINTS;
+  auto continued = Dataset::generate(options);
+  bool continues = std::ranges::all_of(
+      std::views::iota(0UL, CONTINUED_POINTS), [&](size_t i) {
+        return continued.get_point(i) ==
+               sequential.get_point(options.first_index + i);
+      });
+
+  return sequential == parallel && loaded == parallel && continues;
+}
+
+// Test 8: Check that inserts which do not split any node allocate nothing
+inline auto insert_is_allocation_free(
+    SSTree<MAX_POINTS_PER_NODE> &tree,
+    const std::vector<std::shared_ptr<Data>> &data) -> bool {
+  size_t allocations_without_split = 0;
+  for (const auto &data_point : data) {
+    auto nodes = count_nodes(tree.get_root());
+    auto allocations = allocation_count.load();
+    tree.insert(data_point);
+    if (count_nodes(tree.get_root()) == nodes) {
+      allocations_without_split += allocation_count.load() - allocations;
+    }
+  }
+  return allocations_without_split == 0;
+}
+
+// Test 9: Check that the disk-resident tree answers kNN like the in-memory one
+// while reading its leaves through a small buffer pool
+inline auto tiered_matches_in_memory(SSTree<MAX_POINTS_PER_NODE> &tree,
+                                     size_t pool_frames, size_t k) -> bool {
+  auto path =
+      (std::filesystem::temp_directory_path() / "sstree_leaves.bin").string();
+  bool matches = true;
+  {
+    TieredSSTree<MAX_POINTS_PER_NODE> tiered(tree, path, pool_frames);
+    for (size_t query = 0; query < NUM_NEIGHBORS; ++query) {
+      auto target = random_query();
+      auto expected = tree.knn(target, k);
+      auto result = tiered.knn(target, k);
+      matches = matches && result.size() == expected.size() &&
+                std::ranges::equal(result, expected, [](const auto &lhs,
+                                                         const auto &rhs) {
+                  // Results are read back from their page after the search
+                  return std::abs(lhs.distance - rhs.distance) <=
+                             DISTANCE_TOLERANCE &&
+                         lhs.data->get_id() == rhs.data->get_id() &&
+                         lhs.data->get_embedding() ==
+                             rhs.data->get_embedding();
+                });
+    }
+    matches = matches && tiered.get_pool_stats().evictions > 0;
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(TieredSSTree<MAX_POINTS_PER_NODE>::metadata_path(path));
+  return matches;
+}
+
+// Test 10: Check that the auto-tuner measures every candidate capacity and
+// picks one of them, and that trees built with it through the factory answer
+// kNN exactly
+inline auto tuner_picks_working_capacity(
+    const std::vector<std::shared_ptr<Data>> &data, size_t k) -> bool {
+  constexpr size_t NUM_QUERIES = 20;
+  std::vector<Point> queries;
+  for (size_t i = 0; i < NUM_QUERIES; ++i) {
+    queries.push_back(random_query());
+  }
+
+  TuningOptions options;
+  options.k = k;
+  options.candidates = {8, 16, 32};
+  options.repetitions = 1;
+  auto tuning = tune_capacity(data, queries, options);
+
+  auto tree = make_sstree(tuning.max_points_per_node);
+  for (const auto &data_point : data) {
+    tree->insert(data_point);
+  }
+
+  return tuning.trials.size() == options.candidates.size() &&
+         std::ranges::all_of(tuning.trials,
+                             [](const auto &trial) {
+                               return trial.recall == 1.0F;
+                             }) &&
+         std::ranges::find(options.candidates,
+                           tree->get_max_points_per_node()) !=
+             options.candidates.end() &&
+         knn_matches_brute_force(*tree, data, k);
+}
+
+// Test 11: Check that the early-abandoning distance is exact below its bound
+// and stops once it reaches the bound otherwise
+inline auto bounded_distance_is_consistent() -> bool {
+  constexpr size_t NUM_PAIRS = 100;
+  constexpr float RELATIVE_TOLERANCE = 1e-4F;
+
+  bool consistent = true;
+  for (size_t pair = 0; pair < NUM_PAIRS; ++pair) {
+    auto lhs = random_query();
+    auto rhs = random_query();
+    auto exact = Point::squared_distance(lhs.data(), rhs.data());
+    auto full = Point::bounded_squared_distance(
+        lhs.data(), rhs.data(), std::numeric_limits<float>::max());
+    auto abandoned =
+        Point::bounded_squared_distance(lhs.data(), rhs.data(), exact / 2);
+    consistent = consistent &&
+                 std::abs(full - exact) <= RELATIVE_TOLERANCE * exact &&
+                 abandoned >= exact / 2 &&
+                 abandoned < exact * (1 - RELATIVE_TOLERANCE);
+  }
+  return consistent;
+}
+
+// Test 12: Check that a range query returns exactly the entries a brute-force
+// scan finds inside the radius
+template <typename Tree>
+inline auto range_matches_brute_force(
+    const Tree &tree, const std::vector<std::shared_ptr<Data>> &data,
+    size_t expected_size) -> bool {
+  auto query = random_query();
+
+  std::vector<float> expected;
+  std::ranges::transform(data, std::back_inserter(expected),
+                         [&query](const auto &data_point) {
+                           return Point::distance(query,
+                                                  data_point->get_embedding());
+                         });
+  std::ranges::sort(expected);
+  // Halfway between two entries, so rounding cannot move one across it
+  auto radius = (expected[expected_size - 1] + expected[expected_size]) / 2;
+  expected.resize(expected_size);
+
+  auto result = tree.range(query, radius);
+
+  return result.size() == expected.size() &&
+         std::ranges::all_of(std::views::iota(0UL, result.size()),
+                             [&](size_t i) {
+                               return std::abs(result[i].distance -
+                                               expected[i]) <=
+                                      DISTANCE_TOLERANCE;
+                             });
+}
+
+// Test 13: Check that a tiered index streamed from a dataset file answers kNN
+// like a brute-force scan, both right after building it and once reopened
+// from its page and metadata files
+inline auto streamed_tiered_matches_brute_force(
+    const std::vector<std::shared_ptr<Data>> &data, size_t pool_frames,
+    size_t k) -> bool {
+  using Tiered = TieredSSTree<MAX_POINTS_PER_NODE>;
+  auto directory = std::filesystem::temp_directory_path();
+  auto dataset_path = (directory / "sstree_stream.bin").string();
+  auto page_path = (directory / "sstree_stream_leaves.bin").string();
+  generate_random_data_set(data.size()).save(dataset_path);
+
+  auto answers_like_brute_force = [&](const Tiered &tiered) {
+    bool matches = true;
+    for (size_t query = 0; query < NUM_NEIGHBORS; ++query) {
+      auto target = random_query();
+      std::vector<std::pair<float, uint64_t>> expected;
+      for (const auto &data_point : data) {
+        expected.emplace_back(
+            Point::distance(target, data_point->get_embedding()),
+            data_point->get_id());
+      }
+      std::ranges::sort(expected);
+      expected.resize(std::min(k, expected.size()));
+
+      auto result = tiered.knn(target, k);
+      matches = matches && result.size() == expected.size() &&
+                std::ranges::equal(result, expected, [](const auto &lhs,
+                                                         const auto &rhs) {
+                  return std::abs(lhs.distance - rhs.first) <=
+                             DISTANCE_TOLERANCE &&
+                         lhs.data->get_id() == rhs.second;
+                });
+    }
+    return matches;
+  };
+
+  TieredBuildOptions options;
+  options.num_clusters = 8;
+  options.sample_size = data.size() / 4;
+  options.chunk_size = 100;
+  bool matches = true;
+  {
+    auto built = Tiered::build(dataset_path, page_path, pool_frames, options);
+    matches = answers_like_brute_force(*built) &&
+              built->get_pool_stats().evictions > 0;
+  }
+  {
+    auto reopened = Tiered::open(page_path, pool_frames);
+    matches = matches && answers_like_brute_force(*reopened);
+  }
+  std::filesystem::remove(dataset_path);
+  std::filesystem::remove(page_path);
+  std::filesystem::remove(Tiered::metadata_path(page_path));
+  return matches;
+}
+
+// Test 14: Check that requests survive an encode/decode round trip and that
+// malformed ones (k of zero, negative, infinite or NaN radius) are rejected
+inline auto protocol_validates_requests() -> bool {
+  auto decodes = [](const Request &request) {
+    std::vector<char> message;
+    encode_request(request, message);
+    RequestHeader header{};
+    std::memcpy(&header, message.data(), sizeof(header));
+    return decode_request(header,
+                          std::span<const char>(message).subspan(sizeof(header)));
+  };
+  auto knn_request = [](uint32_t k) {
+    return Request{.type = RequestType::KNN,
+                   .request_id = 1,
+                   .query = random_query(),
+                   .k = k};
+  };
+  auto range_request = [](float radius) {
+    return Request{.type = RequestType::RANGE,
+                   .request_id = 2,
+                   .query = random_query(),
+                   .radius = radius};
+  };
+
+  auto knn = decodes(knn_request(NUM_NEIGHBORS));
+  auto range = decodes(range_request(1.0F));
+  return knn && knn->k == NUM_NEIGHBORS && knn->request_id == 1 && range &&
+         range->radius == 1.0F && !decodes(knn_request(0)) &&
+         !decodes(range_request(-1.0F)) &&
+         !decodes(range_request(std::numeric_limits<float>::infinity())) &&
+         !decodes(range_request(std::numeric_limits<float>::quiet_NaN()));
+}
+
+// Test 15: Check that the id-range check is exact at word boundaries, and
+// that it skips whole subtrees when ids follow the layout of the tree
+inline auto id_ranges_prune_subtrees(
+    const std::vector<std::shared_ptr<Data>> &data, size_t k) -> bool {
+  IdBitmap boundaries(256);
+  boundaries.set(63);
+  boundaries.set(128);
+  SearchFilter boundary_filter(boundaries);
+  bool exact =
+      !boundary_filter.may_contain({.min = 64, .max = 127}) &&
+      boundary_filter.may_contain({.min = 63, .max = 64}) &&
+      boundary_filter.may_contain({.min = 127, .max = 128}) &&
+      !boundary_filter.may_contain(
+          {.min = 129, .max = std::numeric_limits<uint64_t>::max()}) &&
+      !boundary_filter.may_contain({});
+
+  // The same inserts build the same tree, now with contiguous ids per subtree
+  SSTree<MAX_POINTS_PER_NODE> layout;
+  for (const auto &data_point : data) {
+    layout.insert(data_point);
+  }
+  std::unordered_map<const Data *, uint64_t> ids;
+  number_by_layout(layout.get_root(), ids);
+  std::vector<std::shared_ptr<Data>> renumbered;
+  SSTree<MAX_POINTS_PER_NODE> tree;
+  for (const auto &data_point : data) {
+    renumbered.push_back(std::make_shared<Data>(data_point->get_embedding(),
+                                                data_point->get_path(),
+                                                ids.at(data_point.get())));
+    tree.insert(renumbered.back());
+  }
+
+  IdBitmap first_quarter(data.size());
+  for (uint64_t id = 0; id < data.size() / 4; ++id) {
+    first_quarter.set(id);
+  }
+  SearchFilter filter(first_quarter);
+  const auto &children = tree.get_root()->get_children();
+  auto skipped = std::ranges::count_if(children, [&filter](const auto &child) {
+    return !filter.may_contain(child->get_id_range());
+  });
+
+  return exact && skipped > 0 &&
+         knn_matches_brute_force(tree, renumbered, k, filter);
+}
+
+// Test 16: Check that early abandoning saves floating-point work: kNN over
+// clustered data evaluates fewer distance blocks than the same distance calls
+// would without abandoning
+inline auto early_abandoning_saves_work(size_t k) -> bool {
+  constexpr size_t NUM_QUERIES = 20;
+  DatasetOptions options{.distribution = Distribution::GAUSSIAN_MIXTURE,
+                         .num_points = NUM_POINTS,
+                         .seed = DATASET_SEED};
+  auto data = Dataset::generate(options).to_data();
+  // New samples of the same clusters
+  options.first_index = NUM_POINTS;
+  options.num_points = NUM_QUERIES;
+  auto queries = Dataset::generate(options);
+
+  SSTree<MAX_POINTS_PER_NODE> tree;
+  for (const auto &data_point : data) {
+    tree.insert(data_point);
+  }
+
+  auto before = Point::distance_work();
+  for (size_t query = 0; query < NUM_QUERIES; ++query) {
+    auto result = tree.knn(queries.get_point(query), k);
+    static_cast<void>(result);
+  }
+  auto work = Point::distance_work() - before;
+  // Without abandoning every call would evaluate all of its blocks; about a
+  // quarter of them are skipped on this data
+  auto full_blocks = work.calls * NUM_DISTANCE_BLOCKS;
+  return work.calls > 0 && work.blocks * 10 < full_blocks * 9;
+}
+
 inline void test_all() {
 
   auto data = generate_random_data(NUM_POINTS);
@@ -187,6 +619,106 @@ inline void test_all() {
   assert(no_node_exceeds_max_children(tree.get_root(), MAX_POINTS_PER_NODE));
   assert(sphere_covers_all_points(tree.get_root()));
   assert(sphere_covers_all_children_spheres(tree.get_root()));
+  assert(knn_matches_brute_force(tree, data, NUM_NEIGHBORS));
+  assert(range_matches_brute_force(tree, data, NUM_NEIGHBORS));
+
+  // Filtered kNN: an id bitmap, a predicate over Data, and both together
+  IdBitmap allowed_ids(NUM_POINTS);
+  for (uint64_t id = 0; id < NUM_POINTS; id += 3) {
+    allowed_ids.set(id);
+  }
+  [[maybe_unused]] auto ends_in_zero = [](const Data &data_point) {
+    return data_point.get_path().ends_with("0.jpg");
+  };
+  assert(knn_matches_brute_force(tree, data, NUM_NEIGHBORS,
+                                 SearchFilter(allowed_ids)));
+  assert(knn_matches_brute_force(tree, data, NUM_NEIGHBORS,
+                                 SearchFilter(ends_in_zero)));
+  assert(knn_matches_brute_force(tree, data, NUM_NEIGHBORS,
+                                 SearchFilter(allowed_ids, ends_in_zero)));
+
+  // Routing through a PCA projection trained on part of the data
+  SSTree<MAX_POINTS_PER_NODE> projected_tree;
+  std::vector<Point> sample;
+  for (size_t i = 0; i < NUM_POINTS / 2; ++i) {
+    projected_tree.insert(data[i]);
+    sample.push_back(data[i]->get_embedding());
+  }
+  projected_tree.set_projection(Projection::pca(sample));
+  for (size_t i = NUM_POINTS / 2; i < NUM_POINTS; ++i) {
+    projected_tree.insert(data[i]);
+  }
+  assert(all_data_present(projected_tree, data));
+  assert(leaves_at_same_level(projected_tree.get_root()));
+  assert(sphere_covers_all_children_spheres(projected_tree.get_root()));
+  assert(knn_matches_brute_force(projected_tree, data, NUM_NEIGHBORS));
+
+  // Same checks through the write buffer, flushed inline one batch per
+  // insert, so it never grows past the threshold
+  SSTree<MAX_POINTS_PER_NODE> inline_tree(
+      WriteBufferOptions{.flush_threshold = 128, .batch_size = 32});
+  for (const auto &data_point : data) {
+    inline_tree.insert(data_point);
+    assert(inline_tree.get_buffered_count() < 128);
+  }
+  assert(knn_matches_brute_force(inline_tree, data, NUM_NEIGHBORS));
+
+  // ...and flushed on a background thread, never past max_buffered
+  SSTree<MAX_POINTS_PER_NODE> buffered_tree(
+      WriteBufferOptions{.flush_threshold = 128,
+                         .batch_size = 32,
+                         .background_flush = true,
+                         .max_buffered = 256});
+  for (const auto &data_point : data) {
+    buffered_tree.insert(data_point);
+    assert(buffered_tree.get_buffered_count() < 256);
+  }
+  assert(knn_matches_brute_force(buffered_tree, data, NUM_NEIGHBORS));
+  assert(range_matches_brute_force(buffered_tree, data, NUM_NEIGHBORS));
+
+  buffered_tree.flush();
+  assert(buffered_tree.get_buffered_count() == 0);
+  assert(all_data_present(buffered_tree, data));
+  assert(sphere_covers_all_children_spheres(buffered_tree.get_root()));
+
+  // Sharded index, partitioned by path hash and by trained clusters
+  for (auto partitioning :
+       {ShardPartitioning::HASH, ShardPartitioning::CLUSTER}) {
+    ShardOptions shard_options;
+    shard_options.partitioning = partitioning;
+    ShardedSSTree<MAX_POINTS_PER_NODE> sharded_tree(shard_options);
+    sharded_tree.train_partitioning(sample);
+    for (const auto &data_point : data) {
+      sharded_tree.insert(data_point);
+    }
+    // Inserts are queued on the shards' writers; flush() waits for them
+    sharded_tree.flush();
+    assert(knn_matches_brute_force(sharded_tree, data, NUM_NEIGHBORS));
+    assert(knn_matches_brute_force(sharded_tree, data, NUM_NEIGHBORS,
+                                   SearchFilter(allowed_ids)));
+  }
+
+  assert(dataset_is_reproducible());
+
+  auto more_data = Dataset::generate({.distribution = Distribution::UNIFORM,
+                                      .num_points = NUM_POINTS,
+                                      .seed = DATASET_SEED + 1})
+                       .to_data();
+  assert(insert_is_allocation_free(tree, more_data));
+
+  [[maybe_unused]] constexpr size_t POOL_FRAMES = 4;
+  assert(tiered_matches_in_memory(tree, POOL_FRAMES, NUM_NEIGHBORS));
+  assert(streamed_tiered_matches_brute_force(data, POOL_FRAMES, NUM_NEIGHBORS));
+
+  assert(tuner_picks_working_capacity(data, NUM_NEIGHBORS));
+
+  assert(bounded_distance_is_consistent());
+
+  assert(protocol_validates_requests());
+
+  assert(id_ranges_prune_subtrees(data, NUM_NEIGHBORS));
+
+  assert(early_abandoning_saves_work(NUM_NEIGHBORS));
 
   std::cout << "Happy ending! :D" << '\n';
 }
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AnySSTree.hpp"
+#include "Dataset.hpp"
+#include "QueryServer.hpp"
+
+namespace {
+
+constexpr std::string_view USAGE =
+    "Usage: SS_TREE_server --socket PATH [--dataset FILE | --points N]\n"
+    "                      [--seed S] [--capacity C] [--max-batch B]\n"
+    "                      [--max-wait-us U] [--workers W]\n";
+
+struct ServerConfig {
+  ServerOptions server;
+  std::string dataset_path;
+  size_t num_points = 10000;
+  uint64_t seed = 42;
+  size_t capacity = 20;
+};
+
+auto parse_args(const std::vector<std::string_view> &args) -> ServerConfig {
+  ServerConfig config;
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (i + 1 == args.size()) {
+      throw std::invalid_argument("Missing value for " + std::string(args[i]));
+    }
+    auto flag = args[i];
+    std::string value(args[++i]);
+    if (flag == "--socket") {
+      config.server.socket_path = value;
+    } else if (flag == "--dataset") {
+      config.dataset_path = value;
+    } else if (flag == "--points") {
+      config.num_points = std::stoul(value);
+    } else if (flag == "--seed") {
+      config.seed = std::stoull(value);
+    } else if (flag == "--capacity") {
+      config.capacity = std::stoul(value);
+    } else if (flag == "--max-batch") {
+      config.server.max_batch_size = std::stoul(value);
+    } else if (flag == "--max-wait-us") {
+      config.server.max_wait = std::chrono::microseconds(std::stol(value));
+    } else if (flag == "--workers") {
+      config.server.num_workers = std::stoul(value);
+    } else {
+      throw std::invalid_argument("Unknown option " + std::string(flag));
+    }
+  }
+  if (config.server.socket_path.empty()) {
+    throw std::invalid_argument("--socket is required");
+  }
+  return config;
+}
+
+// Read by the signal handler; lock-free, so safe to use there
+std::atomic<const QueryServer *> running_server{nullptr};
+
+void handle_signal(int /*signal*/) {
+  if (const auto *server = running_server.load()) {
+    server->stop();
+  }
+}
+
+} // namespace
+
+auto main(int argc, char *argv[]) -> int {
+  ServerConfig config;
+  try {
+    config = parse_args(std::vector<std::string_view>(argv + 1, argv + argc));
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n' << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    Dataset dataset;
+    if (config.dataset_path.empty()) {
+      DatasetOptions options;
+      options.num_points = config.num_points;
+      options.seed = config.seed;
+      dataset = Dataset::generate(options);
+    } else {
+      dataset = Dataset::load(config.dataset_path);
+    }
+
+    auto tree = make_sstree(config.capacity);
+    for (const auto &data : dataset.to_data()) {
+      tree->insert(data);
+    }
+    tree->flush();
+
+    QueryServer server(*tree, config.server);
+    running_server.store(&server);
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    std::cout << "Serving " << dataset.size() << " points on "
+              << config.server.socket_path << '\n';
+    server.run();
+    running_server.store(nullptr);
+
+    const auto &stats = server.get_stats();
+    std::cout << "Served " << stats.requests << " requests in "
+              << stats.batches << " batches over " << stats.connections
+              << " connections\n";
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}